@@ -5,15 +5,43 @@
 
 #include <dailycoin.hpp>
 
+#ifdef DAILYCOIN_INSTRUMENT
+#define DAILYCOIN_COUNT( counter ) (++eosio::token::perf.counter)
+#define DAILYCOIN_PERF_REPORT() perf_report()
+#else
+#define DAILYCOIN_COUNT( counter ) ((void)0)
+#define DAILYCOIN_PERF_REPORT() ((void)0)
+#endif
+
 namespace eosio {
 
+   namespace {
+
+      // Calls require_recipient once per account, for actions that can list an account many times.
+      void notify_once( vector<uint64_t>& notified, name account )
+      {
+         if ( std::find( notified.begin(), notified.end(), account.value ) != notified.end() )
+            return;
+         notified.push_back( account.value );
+         require_recipient( account );
+      }
+
+      // Appends the little-endian bytes of "v" to a packed event stream.
+      template<typename T>
+      void pack( vector<char>& data, const T& v )
+      {
+         const char* bytes = reinterpret_cast<const char*>( &v );
+         data.insert( data.end(), bytes, bytes + sizeof(T) );
+      }
+
+   } // namespace
+
    void token::create( name   issuer,
                        asset  maximum_supply )
    {
       require_auth( _self );
 
-      auto sym = maximum_supply.symbol;
-      check( sym.is_valid(), "invalid symbol name" );
+      const symbol sym = token_symbol( maximum_supply.symbol );
       check( maximum_supply.is_valid(), "invalid supply");
       check( maximum_supply.amount > 0, "max-supply must be positive");
       check( sym.precision() == SYMBOL_PRECISION, "unsupported symbol precision");
@@ -33,27 +61,27 @@ namespace eosio {
 
    void token::issue( name to, asset quantity, string memo )
    {
-      auto sym = quantity.symbol;
-      check( sym.is_valid(), "invalid symbol name" );
+      const symbol sym = token_symbol( quantity.symbol );
       check( memo.size() <= 256, "memo has more than 256 bytes" );
 
-      stats statstable( _self, sym.code().raw() );
-      auto existing = statstable.find( sym.code().raw() );
-      check( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
-      const auto& st = *existing;
+      stats_accumulator stacc( _self, sym.code(), "token with symbol does not exist, create token before issue" );
+      const auto& st = stacc.st;
 
       require_auth( st.issuer );
       check( quantity.is_valid(), "invalid quantity" );
       check( quantity.amount > 0, "must issue positive quantity" );
 
-      check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-      check( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+      stacc.check_symbol( quantity.symbol );
+      check( quantity.amount <= st.max_supply.amount - stacc.get_supply(), "quantity exceeds available supply");
 
-      statstable.modify( st, same_payer, [&]( auto& s ) {
-            s.supply += quantity;
-         });
+      stacc.add_supply( quantity.amount );
+
+      account_cache accts( _self, sym );
+      add_balance( accts, st.issuer, quantity, st.issuer );
 
-      add_balance( st.issuer, quantity, st.issuer );
+      accts.commit();
+      stacc.flush();
+      DAILYCOIN_PERF_REPORT();
 
       if( to != st.issuer ) {
          SEND_INLINE_ACTION( *this, transfer, { {st.issuer, "active"_n} },
@@ -64,14 +92,11 @@ namespace eosio {
 
    void token::retire( asset quantity, string memo )
    {
-      auto sym = quantity.symbol;
-      check( sym.is_valid(), "invalid symbol name" );
+      const symbol sym = token_symbol( quantity.symbol );
       check( memo.size() <= 256, "memo has more than 256 bytes" );
 
-      stats statstable( _self, sym.code().raw() );
-      auto existing = statstable.find( sym.code().raw() );
-      check( existing != statstable.end(), "token with symbol does not exist" );
-      const auto& st = *existing;
+      stats_accumulator stacc( _self, sym.code(), "token with symbol does not exist" );
+      const auto& st = stacc.st;
 
       if ( st.issuer != _self ) // allows anyone to retire the token
          require_auth( st.issuer );
@@ -79,14 +104,16 @@ namespace eosio {
       check( quantity.is_valid(), "invalid quantity" );
       check( quantity.amount > 0, "must retire positive quantity" );
 
-      check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+      stacc.check_symbol( quantity.symbol );
 
-      statstable.modify( st, same_payer, [&]( auto& s ) {
-            s.supply -= quantity;
-            s.burned += quantity;
-         });
+      stacc.add_burned( quantity.amount );
 
-      sub_balance( st.issuer, quantity );
+      account_cache accts( _self, sym );
+      sub_balance( accts, st.issuer, quantity );
+
+      accts.commit();
+      stacc.flush();
+      DAILYCOIN_PERF_REPORT();
    }
 
    void token::transfer( name    from,
@@ -97,22 +124,24 @@ namespace eosio {
       check( from != to, "cannot transfer to self" );
       require_auth( from );
       check( is_account( to ), "to account does not exist");
-      auto sym = quantity.symbol.code();
-      stats statstable( _self, sym.raw() );
-      const auto& st = statstable.get( sym.raw(), "symbol does not exist" );
+      const symbol sym = token_symbol( quantity.symbol );
+      stats_accumulator stacc( _self, sym.code(), "symbol does not exist" );
+      stacc.shard_owner = from;
 
       require_recipient( from );
       require_recipient( to );
 
       check( quantity.is_valid(), "invalid quantity" );
       check( quantity.amount > 0, "must transfer positive quantity" );
-      check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+      stacc.check_symbol( quantity.symbol );
       check( memo.size() <= 256, "memo has more than 256 bytes" );
 
       auto payer = has_auth( to ) ? to : from;
 
+      account_cache accts( _self, sym );
+
       // check for pending dailycoin income and pay the demurrage tax
-      try_ubi_claim( from, quantity.symbol, payer, statstable, st, false );
+      try_ubi_claim( from, sym, payer, stacc, accts, false, false );
 
       // We have to also resolve UBI and pay the tax on the recipient account,
       //   else the amount being transferred to them might be taxed twice later.
@@ -121,28 +150,122 @@ namespace eosio {
       //   and if the ID check fails at that time, you lose all pending UBI.
       //   But this should not be relevant in practice, as people's ID won't
       //   often become invalid at random times for random reasons.
-      try_ubi_claim( to, quantity.symbol, payer, statstable, st, false );
+      try_ubi_claim( to, sym, payer, stacc, accts, false, true );
+
+      sub_balance( accts, from, quantity );
+      add_balance( accts, to, quantity, payer );
+
+      accts.commit();
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
+   }
+
+   void token::transferclose( name from, name to, asset quantity, string memo )
+   {
+      check( from != to, "cannot transfer to self" );
+      require_auth( from );
+      check( is_account( to ), "to account does not exist");
+      const symbol sym = token_symbol( quantity.symbol );
+      stats_accumulator stacc( _self, sym.code(), "symbol does not exist" );
+      stacc.shard_owner = from;
+
+      require_recipient( from );
+      require_recipient( to );
+
+      check( quantity.is_valid(), "invalid quantity" );
+      check( quantity.amount > 0, "must transfer positive quantity" );
+      stacc.check_symbol( quantity.symbol );
+      check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+      auto payer = has_auth( to ) ? to : from;
+
+      account_cache accts( _self, sym );
+      auto& from_account = accts.get( from );
+      check( from_account.exists, "no balance object found" );
+
+      // Same rule as close(), else the account could be opened again and claim twice today.
+      const time_type today = stacc.today;
+      check( from_account.last_claim_day < today, "Cannot close() yet: income was already claimed for today." );
+
+      // Only the tax is settled, since the row is going away: like with close(), any pending
+      //   income of "from" is given up.
+      settle_tax( from, from_account, stacc, today );
+      try_ubi_claim( to, sym, payer, stacc, accts, false, true );
+
+      // "to" is settled first, since its income may be shared back with "from": the row is only
+      //   erased if that left it with nothing more to give up.
+      check( quantity.amount == from_account.balance.amount, "quantity must be the whole balance after demurrage" );
+      check( from_account.last_claim_day < today, "Cannot close() yet: income was already claimed for today." );
+      add_balance( accts, to, quantity, payer );
+      accts.erase( from );
+
+      accts.commit();
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
+   }
+
+   void token::transfermany( name from, vector<payment> payments, string memo )
+   {
+      require_auth( from );
+      check( !payments.empty(), "no payments" );
+      check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+      const symbol sym = token_symbol( payments[0].quantity.symbol );
+      stats_accumulator stacc( _self, sym.code(), "symbol does not exist" );
+      stacc.shard_owner = from;
+      stacc.check_symbol( sym );
+
+      vector<uint64_t> notified;
+      notify_once( notified, from );
+
+      account_cache accts( _self, sym );
+
+      // The sender's income and tax are resolved once for the whole batch.
+      try_ubi_claim( from, sym, from, stacc, accts, false, false );
+
+      // Each receiver is handled as in transfer(), and the sender is debited the total at the end.
+      asset total = asset{0, sym};
+      for ( const auto& p : payments ) {
+         check( from != p.to, "cannot transfer to self" );
+         check( is_account( p.to ), "to account does not exist");
+         check( p.quantity.is_valid(), "invalid quantity" );
+         check( p.quantity.amount > 0, "must transfer positive quantity" );
+         check( p.quantity.symbol == sym, "symbol precision mismatch" );
 
-      sub_balance( from, quantity );
-      add_balance( to, quantity, payer );
+         notify_once( notified, p.to );
+
+         auto payer = has_auth( p.to ) ? p.to : from;
+         try_ubi_claim( p.to, sym, payer, stacc, accts, false, true );
+         add_balance( accts, p.to, p.quantity, payer );
+         total += p.quantity;
+      }
+
+      sub_balance( accts, from, total );
+
+      accts.commit();
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
    }
 
    void token::open( name owner, const symbol& symbol, name ram_payer )
    {
       require_auth( ram_payer );
 
-      auto sym_code_raw = symbol.code().raw();
-      stats statstable( _self, sym_code_raw );
-      const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
-      check( st.supply.symbol == symbol, "symbol precision mismatch" );
-
-      accounts acnts( _self, owner.value );
-      auto it = acnts.find( sym_code_raw );
-      if( it == acnts.end() ) {
-         acnts.emplace( ram_payer, [&]( auto& a ){
-               a.balance = asset{0, symbol};
-               a.last_claim_day = 0;
-            });
+      const auto sym = token_symbol( symbol );
+      stats_accumulator stacc( _self, sym.code(), "symbol does not exist" );
+      check( stacc.st.supply.symbol == sym, "symbol precision mismatch" );
+
+      account_cache accts( _self, sym );
+      accts.sponsor = ram_payer;
+      auto& acct = accts.get( owner );
+      if( !acct.exists ) {
+         check( is_account( owner ), "owner account does not exist" );
+         acct.create( ram_payer );
+         accts.commit();
+         use_payer_quota( ram_payer, accts.sponsored_accounts, stacc.today );
       }
    }
 
@@ -150,14 +273,14 @@ namespace eosio {
    {
       require_auth( owner );
 
-      accounts acnts( _self, owner.value );
-      auto it = acnts.find( symbol.code().raw() );
-      check( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
-      check( it->balance.amount == 0, "Cannot close because the balance is not zero." );
+      account_cache accts( _self, token_symbol( symbol ) );
+      auto& acct = accts.get( owner );
+      check( acct.exists, "Balance row already deleted or never existed. Action won't have any effect." );
+      check( acct.balance.amount == 0, "Cannot close because the balance is not zero." );
       const time_type today = get_today();
 
       // if never claimed (LCD=0), will pass this check always
-      check( it->last_claim_day < today, "Cannot close() yet: income was already claimed for today." );
+      check( acct.last_claim_day < today, "Cannot close() yet: income was already claimed for today." );
 
       // Reward period removed because it is incompatible with the demurrage code.
       //
@@ -166,7 +289,7 @@ namespace eosio {
       //   check( today > last_signup_reward_day, "Cannot close() yet: must wait for the end of the reward period.");
       //}
 
-      acnts.erase( it );
+      accts.erase( owner );
    }
 
    void token::claim( name owner )
@@ -177,38 +300,91 @@ namespace eosio {
    void token::claimfor( name owner, name ram_payer )
    {
       require_recipient( owner );
-      require_recipient( ram_payer );
+      if ( ram_payer != owner )
+         require_recipient( ram_payer );
 
-      // in case the user didn't have an open balance yet, now they will have one.
-      open( owner, COIN_SYMBOL, ram_payer );
+      require_auth( ram_payer );
+
+      stats_accumulator stacc( _self, COIN_SYMBOL.code(), "symbol does not exist" );
+      stacc.shard_owner = ram_payer;
+      stacc.check_symbol( COIN_SYMBOL );
+
+      // in case the user didn't have an open balance yet, now they will have one
+      //   (the same as open(), but written together with the claim).
+      account_cache accts( _self, COIN_SYMBOL );
+      accts.sponsor = ram_payer;
+      auto& owner_account = accts.get( owner );
+      if ( !owner_account.exists ) {
+         check( is_account( owner ), "owner account does not exist" );
+         owner_account.create( ram_payer );
+      }
 
       // now try to claim
-      stats statstable( _self, COIN_SYMBOL.code().raw() );
-      const auto& st = statstable.get( COIN_SYMBOL.code().raw(), "symbol does not exist" );
+      try_ubi_claim( owner, COIN_SYMBOL, ram_payer, stacc, accts, true, false );
 
-      try_ubi_claim( owner, COIN_SYMBOL, ram_payer, statstable, st, true );
+      accts.commit();
+      use_payer_quota( ram_payer, accts.sponsored_accounts, stacc.today );
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
+   }
+
+   void token::claimmany( vector<name> owners, name ram_payer )
+   {
+      vector<uint64_t> notified;
+      notify_once( notified, ram_payer );
+
+      require_auth( ram_payer );
+
+      stats_accumulator stacc( _self, COIN_SYMBOL.code(), "symbol does not exist" );
+      stacc.shard_owner = ram_payer;
+      stacc.check_symbol( COIN_SYMBOL );
+
+      // Same as claimfor() for each owner, except that owners with nothing to claim are
+      //   skipped instead of failing the whole action. An owner listed twice claims once.
+      // Each owner gets their own max_share_payouts, so what a claim shares doesn't depend on
+      //   where the owner is in the list.
+      account_cache accts( _self, COIN_SYMBOL );
+      accts.sponsor = ram_payer;
+      for ( auto owner : owners ) {
+         notify_once( notified, owner );
+
+         auto& owner_account = accts.get( owner );
+         if ( !owner_account.exists ) {
+            check( is_account( owner ), "owner account does not exist" );
+            owner_account.create( ram_payer );
+         }
+
+         accts.share_payouts = 0;
+         try_ubi_claim( owner, COIN_SYMBOL, ram_payer, stacc, accts, false, false );
+      }
+
+      accts.commit();
+      use_payer_quota( ram_payer, accts.sponsored_accounts, stacc.today );
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
    }
 
    void token::burn( name owner, asset quantity )
    {
       require_auth( owner );
 
-      auto sym = quantity.symbol;
-      check( sym.is_valid(), "invalid symbol name" );
-      stats statstable( _self, sym.code().raw() );
-      auto existing = statstable.find( sym.code().raw() );
-      check( existing != statstable.end(), "token with symbol does not exist" );
-      const auto& st = *existing;
+      const symbol sym = token_symbol( quantity.symbol );
+      stats_accumulator stacc( _self, sym.code(), "token with symbol does not exist" );
+      stacc.shard_owner = owner;
       check( quantity.is_valid(), "invalid quantity" );
       check( quantity.amount > 0, "must retire positive quantity" );
-      check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+      stacc.check_symbol( quantity.symbol );
 
-      statstable.modify( st, same_payer, [&]( auto& s ) {
-            s.supply -= quantity;
-            s.burned += quantity;
-         });
+      stacc.add_burned( quantity.amount );
+
+      account_cache accts( _self, sym );
+      sub_balance( accts, owner, quantity );
 
-      sub_balance( owner, quantity );
+      accts.commit();
+      stacc.flush();
+      DAILYCOIN_PERF_REPORT();
    }
 
    void token::income( name to, asset quantity, string memo ) {
@@ -222,45 +398,87 @@ namespace eosio {
 
       check( (percent >= 0) && (percent <= 100), "invalid percent value" );
       check( owner != to , "cannot setshare to self" );
-      check( is_account( to ), "to account does not exist");
+
+      // The pool is owed by the current share percents, which must not change under it.
+      sharepools pools( _self, owner.value );
+      check( pools.find( 0 ) == pools.end(), "share pool must be paid first (see payshares)" );
 
       shares stbl( _self, owner.value );
+      sharetotals totals( _self, owner.value );
+      auto tot = totals.find( 0 );
+
+      // If there is no total yet, this owner either has no shares or has shares that
+      //   were set before totals were kept, so this is the only time they are counted.
+      uint64_t pcsum = 0;
+      uint32_t count = 0;
+      if ( tot == totals.end() ) {
+         for ( auto sit = stbl.begin(); sit != stbl.end(); ++sit ) {
+            pcsum += sit->percent;
+            ++count;
+         }
+      } else {
+         pcsum = tot->percent;
+         count = tot->count;
+      }
+
       auto it = stbl.find( to.value );
       if ( it == stbl.end() ) {
          if (percent > 0) {
+            // An existing share is known to have a valid account, so only a new one is checked.
+            check( is_account( to ), "to account does not exist");
             stbl.emplace( owner, [&]( auto& s ){
                   s.to      = to;
                   s.percent = percent;
               });
+            pcsum += percent;
+            ++count;
          }
       } else {
+         pcsum -= it->percent;
          if (percent > 0) {
             stbl.modify( it, same_payer, [&]( auto& s ) {
                   s.percent = percent;
               });
+            pcsum += percent;
          } else {
             stbl.erase( it );
+            --count;
          }
       }
 
       // If share percent total exceeds 100%, refuse this action
-      uint64_t pcsum = 0;
-      it = stbl.begin();
-      while ( it != stbl.end() ) {
-        pcsum += (*it).percent;
-        ++it;
-      }
       check( pcsum <= 100, "share total would exceed 100%" );
+
+      if ( count == 0 ) {
+         if ( tot != totals.end() )
+            totals.erase( tot );
+      } else if ( tot == totals.end() ) {
+         totals.emplace( owner, [&]( auto& t ){
+               t.percent = pcsum;
+               t.count   = count;
+           });
+      } else {
+         totals.modify( tot, same_payer, [&]( auto& t ) {
+               t.percent = pcsum;
+               t.count   = count;
+           });
+      }
    }
 
    void token::resetshare( name owner )
    {
       require_auth( owner );
+      sharepools pools( _self, owner.value );
+      check( pools.find( 0 ) == pools.end(), "share pool must be paid first (see payshares)" );
       shares stbl( _self, owner.value );
       auto it = stbl.begin();
       while ( it != stbl.end() ) {
          it = stbl.erase( it );
       }
+      sharetotals totals( _self, owner.value );
+      auto tot = totals.find( 0 );
+      if ( tot != totals.end() )
+         totals.erase( tot );
    }
 
    void token::shareincome( name from, name to, asset quantity, uint8_t percent )
@@ -274,7 +492,7 @@ namespace eosio {
    {
       require_auth( owner );
       uint64_t psize = profile.size();
-      check( psize <= 1024, "profile has more than 1024 bytes" );
+      check( psize <= max_profile_size, "profile has more than 1024 bytes" );
       profiles pfs( _self, owner.value );
       auto pf = pfs.find( 0 );
       if( pf == pfs.end() ) {
@@ -292,6 +510,506 @@ namespace eosio {
            pfs.erase( pf );
         }
       }
+
+      profhashes phs( _self, owner.value );
+      auto ph = phs.find( 0 );
+      if( ph != phs.end() )
+         phs.erase( ph );
+   }
+
+   void token::setprofhash( name owner, string profile )
+   {
+      require_auth( owner );
+      uint64_t psize = profile.size();
+      check( psize <= max_profile_size, "profile has more than 1024 bytes" );
+
+      profiles pfs( _self, owner.value );
+      auto pf = pfs.find( 0 );
+      if( pf != pfs.end() )
+         pfs.erase( pf );
+
+      profhashes phs( _self, owner.value );
+      auto ph = phs.find( 0 );
+      if( psize == 0 ) {
+         if ( ph != phs.end() )
+            phs.erase( ph );
+         return;
+      }
+      const checksum256 hash = sha256( profile.data(), profile.size() );
+      if( ph == phs.end() ) {
+         phs.emplace( owner, [&]( auto& p ){
+               p.hash = hash;
+               p.size = psize;
+            });
+      } else {
+         phs.modify( ph, owner, [&]( auto& p ) {
+               p.hash = hash;
+               p.size = psize;
+            });
+      }
+   }
+
+   void token::setprofpart( name owner, uint32_t offset, string data )
+   {
+      require_auth( owner );
+      check( !data.empty(), "profile part is empty" );
+      profiles pfs( _self, owner.value );
+      const auto& pf = pfs.get( 0, "no profile to update" );
+      check( offset <= pf.profile.size(), "offset is past the end of the profile" );
+      check( uint64_t(offset) + data.size() <= max_profile_size, "profile has more than 1024 bytes" );
+      pfs.modify( pf, owner, [&]( auto& p ) {
+            p.profile.replace( offset, data.size(), data );
+         });
+   }
+
+   void token::setlazy( name owner, bool lazy )
+   {
+      require_auth( owner );
+
+      stats_accumulator stacc( _self, COIN_SYMBOL.code(), "symbol does not exist" );
+      stacc.shard_owner = owner;
+      account_cache accts( _self, COIN_SYMBOL );
+
+      auto& acct = accts.get( owner );
+      check( acct.exists, "no balance object found" );
+      check( acct.lazy != lazy, lazy ? "account is already in lazy settlement mode" : "account is not in lazy settlement mode" );
+
+      // Settle the tax and income first, so no tax is owed when the mode changes
+      //   (otherwise leaving lazy mode could charge again for days already settled).
+      try_ubi_claim( owner, COIN_SYMBOL, owner, stacc, accts, false, false );
+
+      // The row gains or loses lazy_settlement, so the owner pays for its RAM from now on.
+      acct.lazy = lazy;
+      acct.payer = owner;
+      acct.dirty = true;
+
+      accts.commit();
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
+   }
+
+   void token::setaccrual( name owner, bool accrual )
+   {
+      require_auth( owner );
+
+      settings sets( _self, owner.value );
+      auto it = sets.find( 0 );
+      uint32_t flags = (it == sets.end()) ? 0 : it->flags;
+      flags = accrual ? (flags | SHARE_ACCRUAL) : (flags & ~SHARE_ACCRUAL);
+
+      // Don't keep a row that only holds the defaults. A pool that isn't empty is still paid by
+      //   payshares() after the mode is turned off.
+      if ( flags == 0 && (it == sets.end() || it->min_notify_amount == 0) ) {
+         if ( it != sets.end() )
+            sets.erase( it );
+      } else if ( it == sets.end() ) {
+         sets.emplace( owner, [&]( auto& s ){
+               s.flags             = flags;
+               s.min_notify_amount = 0;
+            });
+      } else {
+         sets.modify( it, owner, [&]( auto& s ) {
+               s.flags = flags;
+            });
+      }
+   }
+
+   void token::payshares( name owner, name ram_payer )
+   {
+      require_auth( ram_payer );
+
+      sharetotals totals( _self, owner.value );
+      const auto& tot = totals.get( 0, "no shares to pay" );
+
+      // A payout that was cut short is finished before the pool is paid out again.
+      vector<share_payment> pending;
+      bool new_round = false;
+      {
+         sharepools pools( _self, owner.value );
+         auto pl = pools.find( 0 );
+         check( pl != pools.end() && (pl->round_left > 0 || pl->amount > 0), "no share income to pay" );
+         if ( pl->round_left > 0 ) {
+            pending.push_back( share_payment{ owner, pl->round_amount, tot.percent, true, pl->round_left, pl->round_percent, pl->next_to } );
+         } else {
+            pending.push_back( share_payment{ owner, pl->amount, tot.percent, true, pl->amount } );
+            new_round = true;
+         }
+      }
+
+      stats_accumulator stacc( _self, COIN_SYMBOL.code(), "symbol does not exist" );
+      stacc.shard_owner = owner;
+      account_cache accts( _self, COIN_SYMBOL );
+      accts.sponsor = ram_payer;
+      pay_shares( pending, COIN_SYMBOL, ram_payer, stacc, accts );
+
+      // Read again, since the cascade may have added the owner's own income to the pool.
+      sharepools pools( _self, owner.value );
+      auto pl = pools.find( 0 );
+      const share_payment& paid = pending[0];
+      const int64_t amount = new_round ? pl->amount - paid.amount : pl->amount;
+      if ( amount == 0 && paid.left == 0 ) {
+         pools.erase( pl );
+      } else {
+         pools.modify( pl, same_payer, [&]( auto& p ) {
+               p.amount        = amount;
+               p.round_amount  = (paid.left > 0) ? paid.amount : 0;
+               p.round_left    = paid.left;
+               p.round_percent = (paid.left > 0) ? paid.paid_percent : 0;
+               p.next_to       = (paid.left > 0) ? paid.next_to : name();
+            });
+      }
+
+      accts.commit();
+      use_payer_quota( ram_payer, accts.sponsored_accounts, stacc.today );
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
+   }
+
+   void token::setquota( name ram_payer, uint32_t max_per_day )
+   {
+      require_auth( ram_payer );
+
+      const time_type today = get_today();
+      payerquotas quotas( _self, ram_payer.value );
+      auto it = quotas.find( 0 );
+      if ( max_per_day == 0 ) {
+         check( it != quotas.end(), "no quota to remove" );
+         quotas.erase( it );
+      } else if ( it == quotas.end() ) {
+         quotas.emplace( ram_payer, [&]( auto& q ){
+               q.max_per_day = max_per_day;
+               q.available   = max_per_day;
+               q.day         = today;
+            });
+      } else {
+         // Accounts already paid for today still count against the new limit.
+         const uint32_t used = (it->day == today) ? it->max_per_day - it->available : 0;
+         quotas.modify( it, same_payer, [&]( auto& q ) {
+               q.max_per_day = max_per_day;
+               q.available   = (used < max_per_day) ? max_per_day - used : 0;
+               q.day         = today;
+            });
+      }
+   }
+
+   token::balance_view token::viewbalance( name owner )
+   {
+      return get_balance_view( _self, owner, COIN_SYMBOL.code() );
+   }
+
+   void token::addholders( vector<name> owners, name ram_payer )
+   {
+      require_auth( ram_payer );
+
+      account_cache accts( _self, COIN_SYMBOL );
+      for ( const auto& owner : owners ) {
+         auto& acct = accts.get( owner );
+         if ( acct.exists )
+            accts.track( owner, acct, ram_payer );
+      }
+   }
+
+   void token::settle( uint32_t max_accounts )
+   {
+      check( max_accounts > 0, "max_accounts must be positive" );
+
+      stats_accumulator stacc( _self, COIN_SYMBOL.code(), "symbol does not exist" );
+      account_cache accts( _self, COIN_SYMBOL );
+      const time_type today = stacc.today;
+
+      // The holders index is the cursor: settled accounts move to its end, and the accounts that
+      //   have gone the longest without being taxed are always at its start.
+      vector<name> owners;
+      auto idx = accts.holderstable.get_index<"bylastday"_n>();
+      for ( auto it = idx.begin(); it != idx.end() && it->last_day < today && owners.size() < max_accounts; ++it )
+         owners.push_back( it->owner );
+      check( !owners.empty(), "no accounts to settle" );
+
+      for ( const auto& owner : owners ) {
+         // Rows that have no last_settle_day keep their size and payer: the day they were taxed
+         //   is only written to their holders row (see account_cache::get()).
+         settle_tax( owner, accts.get( owner ), stacc, today );
+      }
+
+      accts.commit();
+      stacc.flush();
+      send_events( stacc.today );
+      DAILYCOIN_PERF_REPORT();
+   }
+
+   void token::rollup( const symbol_code& sym_code )
+   {
+#ifdef DAILYCOIN_SHARDED_STATS
+      stats statstable( _self, sym_code.raw() );
+      const auto& st = statstable.get( sym_code.raw(), "symbol does not exist" );
+
+      int64_t supply_delta = 0;
+      int64_t burned_delta = 0;
+      uint64_t claims_delta = 0;
+      stats_shards shards( _self, sym_code.raw() );
+      for ( auto it = shards.begin(); it != shards.end(); ++it ) {
+         if (it->supply_delta == 0 && it->burned_delta == 0 && it->claims_delta == 0)
+            continue;
+         supply_delta += it->supply_delta;
+         burned_delta += it->burned_delta;
+         claims_delta += it->claims_delta;
+         // Zeroed instead of erased, so the next flush to this shard doesn't pay for a new row.
+         shards.modify( it, same_payer, [&]( auto& sh ) {
+               sh.supply_delta = 0;
+               sh.burned_delta = 0;
+               sh.claims_delta = 0;
+            });
+      }
+      check( supply_delta != 0 || burned_delta != 0 || claims_delta != 0, "nothing to roll up" );
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+            s.supply.amount += supply_delta;
+            s.burned.amount += burned_delta;
+            s.claims        += claims_delta;
+         });
+#else
+      check( false, "sharded stats are not enabled" );
+#endif
+   }
+
+   void token::migrate( vector<name> owners )
+   {
+      require_auth( _self );
+
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      migrations migs( _self, _self.value );
+      auto mit = migs.find( 0 );
+      name last_owner = (mit != migs.end()) ? mit->last_owner : name();
+      uint64_t rows = 0;
+
+      // The new rows are billed to the contract: the original RAM payers are refunded when their
+      //   accounts rows are erased, but they can't be billed here without their authorization.
+      account_cache accts( _self, COIN_SYMBOL );
+      for ( const auto& owner : owners ) {
+         if ( accts.get( owner ).migrate( _self ) ) {
+            ++rows;
+            if ( last_owner < owner )
+               last_owner = owner;
+         }
+      }
+      accts.commit();
+
+      if( mit == migs.end() ) {
+         migs.emplace( _self, [&]( auto& m ){
+               m.last_owner = last_owner;
+               m.rows       = rows;
+            });
+      } else {
+         migs.modify( mit, same_payer, [&]( auto& m ) {
+               m.last_owner = last_owner;
+               m.rows      += rows;
+            });
+      }
+#else
+      check( false, "compact accounts are not enabled" );
+#endif
+   }
+
+   // The restored rows are billed to the contract, since their original RAM payers can't be
+   //   billed without their authorization. Owners are checked with is_account like open() does,
+   //   since the transfer and share paths take a balance row as proof that its owner exists.
+   void token::loadaccounts( const symbol& symbol, vector<snapshot_account> rows )
+   {
+      require_auth( _self );
+
+#ifdef DAILYCOIN_RESTORE
+      const auto sym = token_symbol( symbol );
+      stats_accumulator stacc( _self, sym.code(), "symbol does not exist" );
+      stacc.shard_owner = _self;
+      stacc.check_symbol( sym );
+      account_cache accts( _self, sym );
+
+      for ( const auto& r : rows ) {
+         check( r.amount >= 0, "balance cannot be negative" );
+         check( is_account( r.owner ), "owner account does not exist" );
+         auto& acct = accts.get( r.owner );
+         check( !acct.exists, "account already exists" );
+         acct.create( _self );
+         acct.balance.amount  = r.amount;
+         acct.last_claim_day  = r.last_claim_day;
+         acct.last_settle_day = r.last_settle_day;
+         acct.has_settle_day  = (r.last_settle_day != 0);
+         acct.lazy            = r.lazy;
+         stacc.add_supply( r.amount );
+      }
+      check( stacc.get_supply() <= stacc.st.max_supply.amount, "restored balances exceed max supply" );
+
+      accts.commit();
+      stacc.flush();
+#else
+      check( false, "restore is not enabled" );
+#endif
+   }
+
+   void token::loadshares( vector<snapshot_share> rows )
+   {
+      require_auth( _self );
+
+#ifdef DAILYCOIN_RESTORE
+      for ( const auto& r : rows ) {
+         check( (r.percent > 0) && (r.percent <= 100), "invalid percent value" );
+         check( r.owner != r.to, "cannot setshare to self" );
+         check( is_account( r.owner ), "owner account does not exist" );
+         check( is_account( r.to ), "to account does not exist" );
+
+         shares stbl( _self, r.owner.value );
+         check( stbl.find( r.to.value ) == stbl.end(), "share already exists" );
+         stbl.emplace( _self, [&]( auto& s ){
+               s.to      = r.to;
+               s.percent = r.percent;
+            });
+
+         sharetotals totals( _self, r.owner.value );
+         auto tot = totals.find( 0 );
+         if ( tot == totals.end() ) {
+            totals.emplace( _self, [&]( auto& t ){
+                  t.percent = r.percent;
+                  t.count   = 1;
+               });
+         } else {
+            check( tot->percent + r.percent <= 100, "share total would exceed 100%" );
+            totals.modify( tot, same_payer, [&]( auto& t ) {
+                  t.percent += r.percent;
+                  ++t.count;
+               });
+         }
+      }
+#else
+      check( false, "restore is not enabled" );
+#endif
+   }
+
+   void token::loadpools( vector<snapshot_pool> rows )
+   {
+      require_auth( _self );
+
+#ifdef DAILYCOIN_RESTORE
+      stats_accumulator stacc( _self, COIN_SYMBOL.code(), "symbol does not exist" );
+      stacc.shard_owner = _self;
+
+      for ( const auto& r : rows ) {
+         check( r.amount >= 0 && r.round_left >= 0 && r.round_left <= r.round_amount, "invalid pool amounts" );
+         check( r.amount > 0 || r.round_left > 0, "pool is empty" );
+         check( is_account( r.owner ), "owner account does not exist" );
+
+         sharetotals totals( _self, r.owner.value );
+         const auto& tot = totals.get( 0, "no shares to pay" );
+         check( r.round_percent <= tot.percent, "invalid percent value" );
+
+         sharepools pools( _self, r.owner.value );
+         check( pools.find( 0 ) == pools.end(), "pool already exists" );
+         pools.emplace( _self, [&]( auto& p ){
+               p.amount        = r.amount;
+               p.round_amount  = r.round_amount;
+               p.round_left    = r.round_left;
+               p.round_percent = r.round_percent;
+               p.next_to       = r.next_to;
+            });
+         stacc.add_supply( r.amount + r.round_left );
+      }
+      check( stacc.get_supply() <= stacc.st.max_supply.amount, "restored balances exceed max supply" );
+
+      stacc.flush();
+#else
+      check( false, "restore is not enabled" );
+#endif
+   }
+
+   void token::loadprofiles( vector<snapshot_profile> rows )
+   {
+      require_auth( _self );
+
+#ifdef DAILYCOIN_RESTORE
+      for ( const auto& r : rows ) {
+         check( !r.profile.empty(), "profile is empty" );
+         check( r.profile.size() <= max_profile_size, "profile has more than 1024 bytes" );
+         check( is_account( r.owner ), "owner account does not exist" );
+         profiles pfs( _self, r.owner.value );
+         check( pfs.find( 0 ) == pfs.end(), "profile already exists" );
+         pfs.emplace( _self, [&]( auto& p ){
+               p.profile = r.profile;
+            });
+      }
+#else
+      check( false, "restore is not enabled" );
+#endif
+   }
+
+   void token::loadsettings( vector<snapshot_setting> rows )
+   {
+      require_auth( _self );
+
+#ifdef DAILYCOIN_RESTORE
+      for ( const auto& r : rows ) {
+         check( (r.flags & ~(MUTE_ALL | SHARE_ACCRUAL)) == 0, "invalid flags" );
+         check( r.min_notify_amount >= 0, "minimum quantity cannot be negative" );
+         check( is_account( r.owner ), "owner account does not exist" );
+         settings sets( _self, r.owner.value );
+         check( sets.find( 0 ) == sets.end(), "setting already exists" );
+         sets.emplace( _self, [&]( auto& s ){
+               s.flags             = r.flags;
+               s.min_notify_amount = r.min_notify_amount;
+            });
+      }
+#else
+      check( false, "restore is not enabled" );
+#endif
+   }
+
+   void token::loadstat( const symbol_code& sym_code, asset burned, uint64_t claims )
+   {
+      require_auth( _self );
+
+#ifdef DAILYCOIN_RESTORE
+      stats statstable( _self, sym_code.raw() );
+      const auto& st = statstable.get( sym_code.raw(), "symbol does not exist" );
+      check( burned.symbol == st.burned.symbol, "symbol precision mismatch" );
+      check( burned.is_valid() && burned.amount >= 0, "invalid quantity" );
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+            s.burned = burned;
+            s.claims = claims;
+         });
+#else
+      check( false, "restore is not enabled" );
+#endif
+   }
+
+   void token::setnotify( name owner, bool tax, bool income, bool shareincome, asset min_quantity )
+   {
+      require_auth( owner );
+      check( min_quantity.symbol == COIN_SYMBOL, "symbol precision mismatch" );
+      check( min_quantity.is_valid(), "invalid quantity" );
+      check( min_quantity.amount >= 0, "minimum quantity cannot be negative" );
+
+      uint32_t mute = (tax ? 0 : MUTE_TAX) | (income ? 0 : MUTE_INCOME) | (shareincome ? 0 : MUTE_SHAREINCOME);
+
+      settings sets( _self, owner.value );
+      auto it = sets.find( 0 );
+      uint32_t flags = (it == sets.end()) ? mute : ((it->flags & ~MUTE_ALL) | mute);
+
+      // Don't keep a row that only holds the defaults.
+      if ( flags == 0 && min_quantity.amount == 0 ) {
+         if ( it != sets.end() )
+            sets.erase( it );
+      } else if ( it == sets.end() ) {
+         sets.emplace( owner, [&]( auto& s ){
+               s.flags             = flags;
+               s.min_notify_amount = min_quantity.amount;
+            });
+      } else {
+         sets.modify( it, owner, [&]( auto& s ) {
+               s.flags             = flags;
+               s.min_notify_amount = min_quantity.amount;
+            });
+      }
    }
 
 /*
@@ -437,6 +1155,30 @@ namespace eosio {
       require_recipient( owner );
    }
 
+   void token::evpack( vector<char> data ) {
+      require_auth( _self );
+      packed_event_reader reader( data.data(), data.size() );
+      check( reader.valid, "invalid event pack" );
+      vector<uint64_t> notified;
+      packed_event e;
+      while ( reader.next( e ) ) {
+         notify_once( notified, name(e.owner) );
+         if ( e.type == EVENT_SHAREINCOME )
+            notify_once( notified, name(e.to) );
+      }
+      check( reader.valid, "invalid event pack" );
+   }
+
+   void token::events( vector<event_abi> events ) {
+      require_auth( _self );
+      vector<uint64_t> notified;
+      for ( const auto& e : events ) {
+         notify_once( notified, e.owner );
+         if ( e.type == EVENT_SHAREINCOME )
+            notify_once( notified, e.to );
+      }
+   }
+
 /*
    // Debug helper action
    void token::sublcd ( name owner, uint64_t amount ) {
@@ -449,31 +1191,384 @@ namespace eosio {
    }
 */
 
-   void token::sub_balance( name owner, asset value ) {
-      accounts from_acnts( _self, owner.value );
+   token::stats_accumulator::stats_accumulator( name code, symbol_code sym_code, const char* error_msg )
+      : statstable( code, sym_code.raw() ), st( statstable.get( sym_code.raw(), error_msg ) ), today( get_today() )
+   {
+      DAILYCOIN_COUNT( finds );
+   }
 
-      const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
-      check( from.balance.amount >= value.amount, "overdrawn balance" );
+   // The supply including the changes that are still in the stats shards, which are only read
+   //   the first time this is called.
+   int64_t token::stats_accumulator::get_supply()const
+   {
+#ifdef DAILYCOIN_SHARDED_STATS
+      if (!shards_loaded) {
+         stats_shards shards( statstable.get_code(), statstable.get_scope() );
+         for ( const auto& sh : shards ) {
+            DAILYCOIN_COUNT( nexts );
+            shards_supply += sh.supply_delta;
+         }
+         shards_loaded = true;
+      }
+      return st.supply.amount + shards_supply + supply_delta;
+#else
+      return st.supply.amount + supply_delta;
+#endif
+   }
 
-      from_acnts.modify( from, owner, [&]( auto& a ) {
-            a.balance -= value;
+   // Writes the accumulated changes, if any, to the "stat" row, or with DAILYCOIN_SHARDED_STATS
+   //   to the stats shard of the shard_owner, which rollup() folds into the "stat" row later.
+   void token::stats_accumulator::flush()
+   {
+      if (supply_delta == 0 && burned_delta == 0 && claims_delta == 0)
+         return;
+#ifdef DAILYCOIN_DAY_STATS
+      flush_day();
+#endif
+#ifdef DAILYCOIN_SHARDED_STATS
+      const name code = statstable.get_code();
+      stats_shards shards( code, statstable.get_scope() );
+      const uint64_t id = get_stats_shard( shard_owner );
+      DAILYCOIN_COUNT( finds );
+      auto it = shards.find( id );
+      if( it == shards.end() ) {
+         DAILYCOIN_COUNT( emplaces );
+         shards.emplace( code, [&]( auto& sh ){
+               sh.id           = id;
+               sh.supply_delta = supply_delta;
+               sh.burned_delta = burned_delta;
+               sh.claims_delta = claims_delta;
+            });
+      } else {
+         DAILYCOIN_COUNT( modifies );
+         shards.modify( it, same_payer, [&]( auto& sh ) {
+               sh.supply_delta += supply_delta;
+               sh.burned_delta += burned_delta;
+               sh.claims_delta += claims_delta;
+            });
+      }
+      shards_supply += supply_delta;
+#else
+      DAILYCOIN_COUNT( modifies );
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+            s.supply.amount += supply_delta;
+            s.burned.amount += burned_delta;
+            s.claims        += claims_delta;
          });
+#endif
+      supply_delta = 0;
+      burned_delta = 0;
+      claims_delta = 0;
+   }
+
+#ifdef DAILYCOIN_DAY_STATS
+   // Adds the claims, income and tax of the action to today's "daystats" row. A new day's row
+   //   also prunes up to two rows that have fallen out of the day_stats_window.
+   void token::stats_accumulator::flush_day()
+   {
+      if (claims_delta == 0 && income_delta == 0 && tax_delta == 0)
+         return;
+      const name code = statstable.get_code();
+      day_stats days( code, statstable.get_scope() );
+      DAILYCOIN_COUNT( finds );
+      auto it = days.find( today );
+      if( it == days.end() ) {
+         DAILYCOIN_COUNT( emplaces );
+         days.emplace( code, [&]( auto& d ){
+               d.day    = today;
+               d.claims = claims_delta;
+               d.income = income_delta;
+               d.tax    = tax_delta;
+            });
+         for ( int i = 0; i < 2; ++i ) {
+            auto oldest = days.begin();
+            if( oldest->day + day_stats_window > today )
+               break;
+            DAILYCOIN_COUNT( erases );
+            days.erase( oldest );
+         }
+      } else {
+         DAILYCOIN_COUNT( modifies );
+         days.modify( it, same_payer, [&]( auto& d ) {
+               d.claims += claims_delta;
+               d.income += income_delta;
+               d.tax    += tax_delta;
+            });
+      }
+      income_delta = 0;
+      tax_delta    = 0;
+   }
+#endif
+
+   token::account_handle::account_handle( name code, name owner, const symbol& sym )
+      : acnts( code, owner.value ),
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+        holds( code, owner.value ),
+#endif
+        balance( 0, sym ), payer( same_payer )
+   {
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      if( sym == COIN_SYMBOL ) {
+         DAILYCOIN_COUNT( finds );
+         hit = holds.find( 0 );
+         if( hit != holds.end() ) {
+            exists          = true;
+            compact         = true;
+            balance.amount  = hit->amount;
+            last_claim_day  = hit->last_claim_day;
+            has_settle_day  = hit->last_settle_day.has_value();
+            last_settle_day = hit->last_settle_day.value_or( 0 );
+            lazy            = hit->lazy_settlement.value_or( false );
+            tracked_day     = last_day();
+            return;
+         }
+      }
+#endif
+      DAILYCOIN_COUNT( finds );
+      it = acnts.find( sym.code().raw() );
+      if( it != acnts.end() ) {
+         exists          = true;
+         balance         = it->balance;
+         last_claim_day  = it->last_claim_day;
+         has_settle_day  = it->last_settle_day.has_value();
+         last_settle_day = it->last_settle_day.value_or( 0 );
+         lazy            = it->lazy_settlement.value_or( false );
+         tracked_day     = last_day();
+      }
    }
 
-   void token::add_balance( name owner, asset value, name ram_payer )
+   // Starts a new, empty balance row that will be emplaced by commit().
+   void token::account_handle::create( name ram_payer )
    {
-      accounts to_acnts( _self, owner.value );
-      auto to = to_acnts.find( value.symbol.code().raw() );
-      if( to == to_acnts.end() ) {
-         to_acnts.emplace( ram_payer, [&]( auto& a ){
-               a.balance = value;
-               a.last_claim_day = 0;
+      exists         = true;
+      created        = true;
+      dirty          = true;
+      payer          = ram_payer;
+      balance.amount = 0;
+      last_claim_day = 0;
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      compact        = (balance.symbol == COIN_SYMBOL);
+#endif
+   }
+
+   // Writes the row back if it was changed, with one emplace for new rows or one modify.
+   void token::account_handle::commit()
+   {
+      if( !dirty )
+         return;
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      if( compact ) {
+         if( created ) {
+            DAILYCOIN_COUNT( emplaces );
+            hit = holds.emplace( payer, [&]( auto& h ){
+                  h.amount = balance.amount;
+                  write_days( h );
+               });
+            created = false;
+         } else {
+            DAILYCOIN_COUNT( modifies );
+            holds.modify( hit, payer, [&]( auto& h ) {
+                  h.amount = balance.amount;
+                  write_days( h );
+               });
+         }
+         dirty = false;
+         return;
+      }
+#endif
+      if( created ) {
+         DAILYCOIN_COUNT( emplaces );
+         it = acnts.emplace( payer, [&]( auto& a ){
+               a.balance = balance;
+               write_days( a );
             });
+         created = false;
       } else {
-         to_acnts.modify( to, same_payer, [&]( auto& a ) {
-               a.balance += value;
+         DAILYCOIN_COUNT( modifies );
+         acnts.modify( it, payer, [&]( auto& a ) {
+               a.balance = balance;
+               write_days( a );
             });
       }
+      dirty = false;
+   }
+
+   // Deletes the row from the table it was read from.
+   void token::account_handle::erase()
+   {
+      DAILYCOIN_COUNT( erases );
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      if( compact )
+         holds.erase( hit );
+      else
+#endif
+         acnts.erase( it );
+      exists = false;
+      dirty  = false;
+   }
+
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+   // Erases the accounts row and makes commit() emplace it in holdings instead. Returns false if
+   //   there is no accounts row of COIN_SYMBOL to move.
+   bool token::account_handle::migrate( name ram_payer )
+   {
+      if( !exists || compact || created || balance.symbol != COIN_SYMBOL )
+         return false;
+      DAILYCOIN_COUNT( erases );
+      acnts.erase( it );
+      compact = true;
+      created = true;
+      dirty   = true;
+      payer   = ram_payer;
+      return true;
+   }
+#endif
+
+   // Reads the owner's settings row, if any, the first time it is needed in this action.
+   void token::account_handle::load_setting()
+   {
+      if( setting_loaded )
+         return;
+      settings sets( acnts.get_code(), acnts.get_scope() );
+      DAILYCOIN_COUNT( finds );
+      auto it = sets.find( 0 );
+      if( it != sets.end() ) {
+         flags             = it->flags;
+         min_notify_amount = it->min_notify_amount;
+      }
+      setting_loaded = true;
+   }
+
+   // Returns false if the owner has muted this kind of event, or if it is below their minimum.
+   bool token::account_handle::wants_notify( uint32_t mute_flag, int64_t amount )
+   {
+      load_setting();
+      return !(flags & mute_flag) && (amount >= min_notify_amount);
+   }
+
+   // Finds the owner's handle, loading the row from the accounts table the first time.
+   // A row without a last_settle_day may still have been taxed later than its last_claim_day by a
+   //   settle() sweep, which only records that day in the holders row, so it is read from there.
+   token::account_handle& token::account_cache::get( name owner )
+   {
+      auto res = handles.try_emplace( owner.value, code, owner, sym );
+      auto& acct = res.first->second;
+      if( res.second && acct.exists && !acct.has_settle_day && !acct.lazy && sym == COIN_SYMBOL ) {
+         DAILYCOIN_COUNT( finds );
+         auto it = holderstable.find( owner.value );
+         if( it != holderstable.end() && it->last_day > acct.last_claim_day ) {
+            acct.last_settle_day = it->last_day;
+            acct.tracked_day     = it->last_day;
+         }
+      }
+      return acct;
+   }
+
+   void token::account_cache::commit()
+   {
+      for( auto& h : handles ) {
+         auto& acct = h.second;
+         bool moved = acct.created || acct.last_day() != acct.tracked_day;
+         if( acct.created && acct.exists )
+            bill( name(h.first), acct, acct.payer );
+         acct.commit();
+         if( moved && acct.exists && sym == COIN_SYMBOL ) {
+            // A new row has an authorized payer. Rows that predate the holders table and are
+            //   only being credited don't, so the contract pays for their holders row.
+            track( name(h.first), acct, (acct.payer != same_payer) ? acct.payer : code );
+         }
+      }
+   }
+
+   // Erases the owner's balance row and, for COIN_SYMBOL (the only token in the holders table),
+   //   their holders row.
+   void token::account_cache::erase( name owner )
+   {
+      get( owner ).erase();
+      if( sym != COIN_SYMBOL )
+         return;
+      DAILYCOIN_COUNT( finds );
+      auto it = holderstable.find( owner.value );
+      if( it != holderstable.end() ) {
+         DAILYCOIN_COUNT( erases );
+         holderstable.erase( it );
+      }
+   }
+
+   // Adds or updates the owner's holders row.
+   void token::account_cache::track( name owner, account_handle& acct, name ram_payer )
+   {
+      const time_type day = acct.last_day();
+      DAILYCOIN_COUNT( finds );
+      auto it = holderstable.find( owner.value );
+      if( it == holderstable.end() ) {
+         DAILYCOIN_COUNT( emplaces );
+         holderstable.emplace( ram_payer, [&]( auto& h ){
+               h.owner    = owner;
+               h.last_day = day;
+            });
+         bill( owner, acct, ram_payer );
+      } else if( it->last_day != day ) {
+         DAILYCOIN_COUNT( modifies );
+         holderstable.modify( it, same_payer, [&]( auto& h ) {
+               h.last_day = day;
+            });
+      }
+      acct.tracked_day = day;
+   }
+
+   // Counts "owner" once against the sponsor's quota when a new row of theirs is billed to it,
+   //   so that a new account costs one unit however many rows (balance, holders, share pool) it
+   //   needs.
+   void token::account_cache::bill( name owner, account_handle& acct, name ram_payer )
+   {
+      if( ram_payer == sponsor && owner != sponsor && !acct.sponsored ) {
+         acct.sponsored = true;
+         ++sponsored_accounts;
+      }
+   }
+
+   void token::sub_balance( account_cache& accts, name owner, asset value ) {
+      auto& from = accts.get( owner );
+
+      check( from.exists, "no balance object found" );
+      check( from.balance.amount >= value.amount, "overdrawn balance" );
+
+      from.balance -= value;
+      from.payer = owner;
+      from.dirty = true;
+   }
+
+   void token::add_balance( account_cache& accts, name owner, asset value, name ram_payer )
+   {
+      auto& to = accts.get( owner );
+      // The owner of a new row was already checked once on every path that gets here: transfer
+      //   receivers by is_account(), share recipients by setshare() (accounts are never deleted),
+      //   and claimants by is_account() or their own authorization.
+      if( !to.exists )
+         to.create( ram_payer );
+      to.balance += value;
+      to.dirty = true;
+   }
+
+   // Takes "new_accounts" sponsored accounts from the payer's daily quota, if they have set one.
+   //   The bucket is refilled to max_per_day on the first use of each day.
+   void token::use_payer_quota( name ram_payer, uint32_t new_accounts, time_type today )
+   {
+      if ( new_accounts == 0 )
+         return;
+      payerquotas quotas( _self, ram_payer.value );
+      DAILYCOIN_COUNT( finds );
+      auto it = quotas.find( 0 );
+      if ( it == quotas.end() )
+         return;
+      const uint32_t available = (it->day < today) ? it->max_per_day : it->available;
+      check( new_accounts <= available, "ram_payer has reached its daily quota of new accounts" );
+      DAILYCOIN_COUNT( modifies );
+      quotas.modify( it, same_payer, [&]( auto& q ) {
+            q.available = available - new_accounts;
+            q.day       = today;
+         });
    }
 
 /*
@@ -516,26 +1611,65 @@ namespace eosio {
    }
 */
 
-   void token::try_ubi_claim( name from, const symbol& sym, name payer, stats& statstable, const currency_stats& st, bool fail )
+   // Charges the demurrage tax that the account owes up to "today" (if any) and marks it as
+   //   settled on that day. The last_claim_day is left to the caller.
+   void token::settle_tax( name owner, account_handle& acct, stats_accumulator& stacc, time_type today )
    {
-      accounts from_acnts( _self, from.value );
-      const auto from_account_it = from_acnts.find( sym.code().raw() );
-      if (from_account_it == from_acnts.end()) {
+      int64_t ni_days = get_unsettled_days( acct.last_claim_day, acct.last_settle_day, today );
+      if (acct.last_settle_day < today) {
+         acct.last_settle_day = today;
+         acct.dirty = true;
+      }
+
+      // Compute the demurrage charge value over the user's balance
+      int64_t burn_amt = get_demurrage_tax( acct.balance.amount, ni_days );
+      if (burn_amt > 0) {
+         asset burn_quantity = asset{burn_amt, acct.balance.symbol};
+
+         // Update the balance to reflect the amount of money destroyed by the demurrage tax.
+         acct.balance.amount -= burn_amt;
+         acct.dirty = true;
+
+         // Log the destruction of money by the demurrage tax (otherwise there's no way
+         //   to know, since we are subtracting from the user's balance directly).
+         if ( acct.wants_notify( MUTE_TAX, burn_amt ) )
+            log_tax( owner, burn_quantity );
+
+         // Update the token total supply and the total burned amount.
+         stacc.add_tax( burn_amt );
+      }
+   }
+
+   // Pays the demurrage tax of "from" and works out their UBI income, which is issued but not yet
+   //   credited to anyone; try_ubi_claim() pays it out. Returns the income, or zero if there is none.
+   // An account is settled at most once per action.
+   asset token::settle_claim( name from, const symbol& sym, stats_accumulator& stacc, account_cache& accts, bool fail, bool receiving )
+   {
+      auto& from_account = accts.get( from );
+      if (!from_account.exists) {
          if (fail)
             check( false, "no balance object found" );
-         return;
+         return asset{0, sym};
       }
-      const auto& from_account = *from_account_it;
 
-      const time_type today = get_today();
+      const time_type today = stacc.today;
+
+      // An account in lazy settlement mode that is only receiving tokens pays the tax it owes up
+      //   to today, so what it receives won't be taxed for days before it arrived, but it keeps
+      //   its pending income, and its last_claim_day, until its next debit or claim.
+      if (receiving && from_account.lazy) {
+         settle_tax( from, from_account, stacc, today );
+         return asset{0, sym};
+      }
 
       time_type curr_lcd = from_account.last_claim_day;
 
-      if (curr_lcd >= today) {
+      if (curr_lcd >= today || from_account.settled) {
          if (fail)
             check( false, "no pending income to claim" );
-         return;
+         return asset{0, sym};
       }
+      from_account.settled = true;
 
       // We are stealing the UBI claim time counter to implement the negative interest
       //   (demurrage) feature also. For that, we do the demurrage calculation and the
@@ -545,39 +1679,13 @@ namespace eosio {
       //   has indeed elapsed. If a person's ID check fails, that will mean they will
       //   lose any accumulated UBI payment for the period that the time counter will
       //   advance.
+      settle_tax( from, from_account, stacc, today );
 
-      int ni_days = 1; // negative interest days elapsed defaults to 1
-      if (curr_lcd > 0) {
-        ni_days = today - curr_lcd; // curr_lcd < today, so ni_days is at least 1
-      }
-
-      // Compute the demurrage charge value over the user's balance
-      double pw = pow(0.995, ((double)ni_days) / 365.0);
-      double dv = pw * from_account.balance.amount;
-      int64_t burn_amt = from_account.balance.amount - ((int64_t)dv);
-      if (burn_amt > 0) {
-         asset burn_quantity = asset{burn_amt, from_account.balance.symbol};
-
-         // Demurrage has been and income will be computed to this exact day when this
-         //   function finishes (no matter how it does finish), which is why we set
-         //   the last_claim_day to today unconditionally here.
-         // Also update the balance to reflect the amount of money destroyed by the
-         //   demurrage tax.
-         from_acnts.modify( from_account, same_payer, [&]( auto& a ) {
-               a.last_claim_day = today;
-               a.balance.amount -= burn_amt;
-            });
-
-         // Log the destruction of money by the demurrage tax (otherwise there's no way
-         //   to know, since we are subtracting from the user's balance directly).
-         log_tax( from, burn_quantity );
-
-         // Update the token total supply and the total burned amount.
-         statstable.modify( st, same_payer, [&]( auto& s ) {
-               s.supply -= burn_quantity;
-               s.burned += burn_quantity;
-            });
-      }
+      // Demurrage has been and income will be computed to this exact day when this
+      //   function finishes (no matter how it does finish), which is why we set
+      //   the last_claim_day to today unconditionally here.
+      from_account.last_claim_day = today;
+      from_account.dirty = true;
 
       // *****************************************************************************
       // TODO: check if this account has verified identity
@@ -593,48 +1701,14 @@ namespace eosio {
       //      return;
       // }
 
-      // NEW: Removed the reward period logic, as it is incompatible with the demurrage code.
-      //
-      // If we are NOT in the reward period, then a last_claim_day of zero means YESTERDAY,
-      //   that is, you get ONE token when you successfully claim for the first time today
-      //   in a verified account.
-      // Otherwise it means the user is entitled to an additional bonus which is the number
-      //   of days until the bonus deadline. We force the bonus by emulating a "last claim
-      //   date" value pushed into the past as needed (capped at max_past_claim_days).
-      if (curr_lcd == 0) {
-        curr_lcd = today - 1;
-        //if (today <= last_signup_reward_day) {
-        //  int64_t bonus_days = last_signup_reward_day - today + 1;
-        //  if (bonus_days > max_past_claim_days) {
-        //    bonus_days = max_past_claim_days;
-        //  }
-        //  curr_lcd -= bonus_days;
-        //}
-      }
-
-      // The UBI grants 1 token per day per account.
-      // The 0.5% per year demurrage tax is not applied to accumulated UBI income, because the difference
-      //   is negligible. Can be interpreted as a pseudo-staking bonus for "locking" the tokens for 1 yr.
-
-      // Compute the claim amount relative to days elapsed since the last claim, excluding today's pay.
-      // If you claimed yesterday, this is zero.
-      int64_t claim_amount = today - curr_lcd - 1;
-
-      // The limit for claiming accumulated past income is 360 days/coins. Unclaimed tokens past that
-      //   one year maximum of accumulation are lost.
-      time_type lost_days = 0;
-      if (claim_amount > max_past_claim_days) {
-         lost_days = claim_amount - max_past_claim_days;
-         claim_amount = max_past_claim_days;
-      }
-
-      // Claim for one day.
-      claim_amount += 1;
-
-      asset claim_quantity = asset{claim_amount * PRECISION_MULTIPLIER, sym};
+      ubi_claim claim = get_ubi_claim( curr_lcd, today );
+      curr_lcd = claim.from_day;
+      time_type lost_days = claim.lost_days;
+
+      asset claim_quantity = asset{claim.amount, sym};
 
       // Respect the max_supply limit for UBI issuance (should never trigger).
-      int64_t available_amount = st.max_supply.amount - st.supply.amount;
+      int64_t available_amount = stacc.st.max_supply.amount - stacc.get_supply();
       if (claim_quantity.amount > available_amount)
          claim_quantity.set_amount(available_amount);
 
@@ -643,17 +1717,24 @@ namespace eosio {
       if (claim_quantity.amount <= 0) {
          if (fail)
             check( false, "no coins" );
-         return;
+         return asset{0, sym};
       }
 
       // Log this basic income payment with an inline "income" action.
-      log_claim( from, claim_quantity, curr_lcd + last_claim_day_delta, lost_days );
+      if ( from_account.wants_notify( MUTE_INCOME, claim_quantity.amount ) )
+         log_claim( from, claim_quantity, curr_lcd + last_claim_day_delta, lost_days );
 
       // Update the token total supply and claims count.
-      statstable.modify( st, same_payer, [&]( auto& s ) {
-            s.supply += claim_quantity;
-            ++s.claims;
-         });
+      stacc.add_claim( claim_quantity.amount );
+
+      return claim_quantity;
+   }
+
+   void token::try_ubi_claim( name from, const symbol& sym, name payer, stats_accumulator& stacc, account_cache& accts, bool fail, bool receiving )
+   {
+      asset claim_quantity = settle_claim( from, sym, stacc, accts, fail, receiving );
+      if (claim_quantity.amount <= 0)
+         return;
 
       // NEW: The demurrage logic changes this. The last_claim_day is updated after the demurrage charge.
       //      Any UBI payment that can't be collected after the demurrage charge, for whatever reason,
@@ -673,55 +1754,9 @@ namespace eosio {
       // Each income share is logged as a shareincome action so the parties involved can understand
       //   what's going on.
 
-      int64_t total_share_available = claim_quantity.amount;
-      int64_t share_available = total_share_available;
-
-      uint64_t pcsum = 0;
-      shares stbl( _self, from.value );
-      auto it = stbl.begin();
-      while ( (it != stbl.end()) && (share_available > 0) ) {
-        const auto& sh = *it;
-
-        int64_t shareamt = 0;
-        pcsum += sh.percent;
-
-        if ( pcsum >= 100 ) {
-          // Last share: give everything, including all the truncation error
-          shareamt = share_available;
-        } else {
-          // Not last share: give its percent w.r.t. to the total available
-          //   for sharing, truncating the fractional part (rounds down)
-          shareamt = (total_share_available * sh.percent) / 100;
-        }
-
-        // apply the shareamt
-        share_available -= shareamt;
-        asset share_quantity = asset{shareamt, sym};
-
-        // Resolve UBI and tax for the target account of the shareincome. We need to
-        //   do this because we are adding tokens to an account and it must resolve
-        //   tax before it can receive new tokens, so the new tokens won't be taxed
-        //   twice/unduly later. And since tax and UBI share the same time field
-        //   (last_claim_day), we need to solve the tax, then the UBI, if any.
-        // Thanks to the last_claim_day being updated during the tax calculation that
-        //   already happened at the beginning of this function call, this recursive
-        //   call should not loop on us.
-        try_ubi_claim( sh.to, sym, payer, statstable, st, false );
-
-        // log the giving and give it
-        log_share( from, sh.to, share_quantity, sh.percent );
-        add_balance( sh.to, share_quantity, payer );
-
-        // search for the next entry in the shares table
-        ++it;
-      }
-
-      // Here we are either out of accounts to receive a share of income, or out of income.
-      // If we still have income left (i.e., the former case) then give it to the UBI claimer.
-      if ( share_available > 0 ) {
-        claim_quantity.set_amount( share_available );
-        add_balance( from, claim_quantity, payer );
-      }
+      vector<share_payment> pending;
+      pending.push_back( share_payment{ from, claim_quantity.amount, 100, false } );
+      pay_shares( pending, sym, payer, stacc, accts );
 
       // ONCE per day, we will also incur the cost of checking for unlocking refunds, which is
       //   an acceptable overhead.
@@ -733,6 +1768,137 @@ namespace eosio {
       //try_refund( from, payer, false );
    }
 
+   // Pays the shares of every income in "pending". Share recipients have their own tax and UBI
+   //   resolved before they are credited (see below), and the income they claim is then shared in
+   //   turn. Instead of recursing, every claimed income waits in "pending" until its owner's shares
+   //   are paid. Each account is settled once per action, so cycles in the share graph end there.
+   // The shares of the first giver are always all paid, as they were before. The cascade that
+   //   follows is what can grow without bound, so after max_share_payouts payouts to the shares of
+   //   share recipients, any income they have left is simply kept by whoever claimed it.
+   // A share pool counts against max_share_payouts too, but what it still owes is never given to
+   //   its owner: the payment says where it stopped, so payshares() can keep it in the pool.
+   void token::pay_shares( vector<share_payment>& pending, const symbol& sym, name payer, stats_accumulator& stacc, account_cache& accts )
+   {
+      for ( size_t i = 0; i < pending.size(); ++i ) {
+        const name giver = pending[i].giver;
+        const bool pooled = pending[i].pooled;
+        const bool capped = (i > 0) || pooled;
+        const uint64_t total_percent = pending[i].percent;
+        int64_t total_share_available = pending[i].amount;
+        int64_t share_available = pooled ? pending[i].left : total_share_available;
+        auto& giver_account = accts.get( giver );
+
+        // In share accrual mode the shared part only goes to the giver's pool, for payshares().
+        if ( !pooled && accrue_shares( giver, giver_account, total_share_available, sym, payer, accts ) )
+          continue;
+
+        uint64_t pcsum = pooled ? pending[i].paid_percent : 0;
+        shares stbl( _self, giver.value );
+        DAILYCOIN_COUNT( finds );
+        auto it = pooled ? stbl.lower_bound( pending[i].next_to.value ) : stbl.begin();
+        while ( (it != stbl.end()) && (share_available > 0) && (!capped || accts.share_payouts < max_share_payouts) ) {
+          const auto& sh = *it;
+
+          int64_t shareamt = 0;
+          pcsum += sh.percent;
+
+          if ( pcsum >= total_percent ) {
+            // Last share: give everything, including all the truncation error
+            shareamt = share_available;
+          } else {
+            // Not last share: give its percent w.r.t. to the total available
+            //   for sharing, truncating the fractional part (rounds down)
+            shareamt = (total_share_available * sh.percent) / total_percent;
+          }
+
+          // apply the shareamt
+          share_available -= shareamt;
+          asset share_quantity = asset{shareamt, sym};
+          if ( capped )
+            ++accts.share_payouts;
+          DAILYCOIN_COUNT( share_payouts );
+
+          // Resolve UBI and tax for the target account of the shareincome. We need to
+          //   do this because we are adding tokens to an account and it must resolve
+          //   tax before it can receive new tokens, so the new tokens won't be taxed
+          //   twice/unduly later. And since tax and UBI share the same time field
+          //   (last_claim_day), we need to solve the tax, then the UBI, if any.
+          // The target's own income, if any, is shared later in this same loop.
+          asset target_claim = settle_claim( sh.to, sym, stacc, accts, false, true );
+          if ( target_claim.amount > 0 )
+            pending.push_back( share_payment{ sh.to, target_claim.amount, 100, false } );
+
+          // log the giving and give it
+          if ( giver_account.wants_notify( MUTE_SHAREINCOME, shareamt ) )
+            log_share( giver, sh.to, share_quantity, sh.percent );
+          add_balance( accts, sh.to, share_quantity, payer );
+
+          // search for the next entry in the shares table
+          DAILYCOIN_COUNT( nexts );
+          ++it;
+        }
+
+        // Here we are either out of accounts to receive a share of income, out of income, or
+        //   out of share payouts for this action.
+        // What a pool still owes its shares when the payouts run out stays in the pool.
+        if ( pooled ) {
+          pending[i].left         = (it != stbl.end()) ? share_available : 0;
+          pending[i].paid_percent = pcsum;
+          pending[i].next_to      = (it != stbl.end()) ? it->to : name();
+          if ( pending[i].left > 0 )
+            continue;
+        }
+
+        // If we still have income left then give it to the UBI claimer.
+        if ( share_available > 0 ) {
+          add_balance( accts, giver, asset{share_available, sym}, payer );
+        }
+      }
+   }
+
+   // If the giver is in share accrual mode, keeps their part of "amount" and adds the part that
+   //   their shares are owed to their share pool, with one read and one write whatever the number
+   //   of shares. Returns false, with nothing done, if the income has to be shared right away.
+   bool token::accrue_shares( name giver, account_handle& giver_account, int64_t amount, const symbol& sym, name payer, account_cache& accts )
+   {
+      giver_account.load_setting();
+      if ( !(giver_account.flags & SHARE_ACCRUAL) || sym != COIN_SYMBOL )
+         return false;
+
+      // The pool is paid out by the share percent total, so owners that set their shares before
+      //   sharetotals existed share right away until their next setshare().
+      sharetotals totals( _self, giver.value );
+      DAILYCOIN_COUNT( finds );
+      auto tot = totals.find( 0 );
+      if ( tot == totals.end() )
+         return false;
+
+      const int64_t pooled = (amount * tot->percent) / 100;
+      if ( pooled > 0 ) {
+         sharepools pools( _self, giver.value );
+         DAILYCOIN_COUNT( finds );
+         auto pl = pools.find( 0 );
+         if ( pl == pools.end() ) {
+            DAILYCOIN_COUNT( emplaces );
+            pools.emplace( payer, [&]( auto& p ){
+                  p.amount        = pooled;
+                  p.round_amount  = 0;
+                  p.round_left    = 0;
+                  p.round_percent = 0;
+               });
+            accts.bill( giver, giver_account, payer );
+         } else {
+            DAILYCOIN_COUNT( modifies );
+            pools.modify( pl, same_payer, [&]( auto& p ) {
+                  p.amount += pooled;
+               });
+         }
+      }
+      if ( amount > pooled )
+         add_balance( accts, giver, asset{amount - pooled, sym}, payer );
+      return true;
+   }
+
 /*
    // Logs the result of a lock action
    void token::log_lock( name owner, asset locker_balance, asset unlocker_balance, asset token_delta ) {
@@ -767,48 +1933,176 @@ namespace eosio {
    }
 */
 
+   namespace {
+
+      // "00" to "99", so that numbers are written two digits at a time.
+      struct digit_pair_table {
+         char digits[200];
+
+         constexpr digit_pair_table() : digits() {
+            for (int i = 0; i < 100; ++i) {
+               digits[2 * i]     = (char)('0' + i / 10);
+               digits[2 * i + 1] = (char)('0' + i % 10);
+            }
+         }
+      };
+
+      constexpr digit_pair_table digit_pairs;
+
+      // Writes "n" in decimal at "p", padded with zeroes to at least "width" digits, and
+      //   returns the end of what was written.
+      char* write_uint( char* p, uint64_t n, int width = 1 )
+      {
+         char tmp[20];
+         char* t = tmp + sizeof(tmp);
+         while (n >= 100) {
+            t -= 2;
+            memcpy( t, &digit_pairs.digits[2 * (n % 100)], 2 );
+            n /= 100;
+         }
+         if (n >= 10) {
+            t -= 2;
+            memcpy( t, &digit_pairs.digits[2 * n], 2 );
+         } else {
+            *--t = (char)('0' + n);
+         }
+         while (tmp + sizeof(tmp) - t < width)
+            *--t = '0';
+         size_t len = tmp + sizeof(tmp) - t;
+         memcpy( p, t, len );
+         return p + len;
+      }
+
+      // Writes a string literal at "p", without its terminator, and returns the end.
+      template<size_t N>
+      char* write_text( char* p, const char (&text)[N] )
+      {
+         memcpy( p, text, N - 1 );
+         return p + N - 1;
+      }
+   }
+
    // Logs the result of a tax action
    void token::log_tax( name owner, asset burned_quantity ) {
+#ifdef DAILYCOIN_BATCH_EVENTS
+      pending_events.push_back( event_abi { .type=EVENT_TAX, .owner=owner, .quantity=burned_quantity } );
+#else
+      DAILYCOIN_COUNT( sends );
       action {
          permission_level{_self, name("active")},
             _self,
                name("tax"),
                tax_notification_abi { .owner=owner, .quantity=burned_quantity }
       }.send();
+#endif
    }
 
    // Logs the UBI claim as an "income" action that only the contract can call.
    void token::log_claim( name claimant, asset claim_quantity, time_type next_last_claim_day, time_type lost_days )
    {
-      string claim_memo = "next on ";
-      claim_memo.append( days_to_string(next_last_claim_day + 1) );
+#ifdef DAILYCOIN_BATCH_EVENTS
+      pending_events.push_back( event_abi { .type=EVENT_INCOME, .owner=claimant, .quantity=claim_quantity,
+         .next_claim_day=next_last_claim_day + 1, .lost_days=lost_days } );
+#else
+      // The memo is formatted in a stack buffer and copied into a string once.
+      char memo[64];
+      char* p = write_text( memo, "next on " );
+      p = write_date( p, next_last_claim_day + 1 );
       if (lost_days > 0) {
-         claim_memo.append(", lost ");
-         claim_memo.append( std::to_string(lost_days) );
-         claim_memo.append(" days of income.");
+         p = write_text( p, ", lost " );
+         p = write_uint( p, lost_days );
+         p = write_text( p, " days of income." );
       }
 
+      DAILYCOIN_COUNT( sends );
       action {
          permission_level{_self, name("active")},
          _self,
          name("income"),
-         income_notification_abi { .to=claimant, .quantity=claim_quantity, .memo=claim_memo }
+         income_notification_abi { .to=claimant, .quantity=claim_quantity, .memo=string( memo, p - memo ) }
       }.send();
+#endif
    }
 
    // Log an UBI share.
    void token::log_share( name giver, name receiver, asset share_quantity, uint8_t share_percent )
    {
+#ifdef DAILYCOIN_BATCH_EVENTS
+      pending_events.push_back( event_abi { .type=EVENT_SHAREINCOME, .owner=giver, .to=receiver,
+         .quantity=share_quantity, .percent=share_percent } );
+#else
+      DAILYCOIN_COUNT( sends );
       action {
          permission_level{_self, name("active")},
          _self,
          name("shareincome"),
          shareincome_notification_abi { .from=giver, .to=receiver, .quantity=share_quantity, .percent=share_percent }
       }.send();
+#endif
+   }
+
+#ifdef DAILYCOIN_INSTRUMENT
+   token::perf_counters token::perf;
+
+   // Prints the counts of the action to the console of the transaction trace.
+   void token::perf_report()
+   {
+      print( "perf: find=", perf.finds, " modify=", perf.modifies, " emplace=", perf.emplaces,
+             " erase=", perf.erases, " next=", perf.nexts, " send=", perf.sends,
+             " share_payouts=", perf.share_payouts, "\n" );
+      perf = perf_counters{};
+   }
+#endif
+
+   // Sends the events collected by the log_*() functions as one "events" action. Without
+   //   DAILYCOIN_BATCH_EVENTS every event was already sent on its own, so this does nothing.
+   void token::send_events( time_type today )
+   {
+      (void)today; // only read by the packed event stream
+#ifdef DAILYCOIN_BATCH_EVENTS
+      if ( pending_events.empty() )
+         return;
+      DAILYCOIN_COUNT( sends );
+#ifdef DAILYCOIN_PACKED_EVENTS
+      vector<char> data;
+      data.reserve( EVENT_PACK_HEADER_SIZE + pending_events.size() * 26 );
+      pack( data, EVENT_PACK_VERSION );
+      pack( data, pending_events[0].quantity.symbol.raw() );
+      pack( data, today );
+      for ( const auto& e : pending_events ) {
+         pack( data, e.type );
+         pack( data, e.owner.value );
+         pack( data, e.quantity.amount );
+         if ( e.type == EVENT_INCOME ) {
+            // Income is claimed up to today, so the next claim day is tomorrow, or a few days
+            //   earlier if the claim was cut by the max_supply limit.
+            pack( data, int16_t(int64_t(e.next_claim_day) - today) );
+            pack( data, e.lost_days );
+         } else if ( e.type == EVENT_SHAREINCOME ) {
+            pack( data, e.to.value );
+            pack( data, e.percent );
+         }
+      }
+      action {
+         permission_level{_self, name("active")},
+         _self,
+         name("evpack"),
+         data
+      }.send();
+#else
+      action {
+         permission_level{_self, name("active")},
+         _self,
+         name("events"),
+         pending_events
+      }.send();
+#endif
+      pending_events.clear();
+#endif
    }
 
-   // "days" is days since epoch
-   string token::days_to_string( int64_t days )
+   // Writes "days" (days since epoch) at "p" as DD-MM-YYYY and returns the end of the date.
+   char* token::write_date( char* p, int64_t days )
    {
       // https://stackoverflow.com/questions/7960318/math-to-convert-seconds-since-1970-into-date-and-vice-versa
       // http://howardhinnant.github.io/date_algorithms.html
@@ -822,19 +2116,13 @@ namespace eosio {
       const unsigned d = doy - (153*mp+2)/5 + 1;                             // [1, 31]
       const unsigned m = mp + (mp < 10 ? 3 : -9);                            // [1, 12]
 
-      string s = std::to_string(d);
-      if (s.length() == 1)
-         s = "0" + s;
-      s.append("-");
-      string ms = std::to_string(m);
-      if (ms.length() == 1)
-         ms = "0" + ms;
-      s.append( ms );
-      s.append("-");
-      s.append( std::to_string(y + (m <= 2)) );
-      return s;
+      p = write_uint( p, d, 2 );
+      *p++ = '-';
+      p = write_uint( p, m, 2 );
+      *p++ = '-';
+      return write_uint( p, y + (m <= 2) );
    }
 
 } /// namespace eosio
 
-EOSIO_DISPATCH( eosio::token, (create)(issue)(transfer)(open)(close)(retire)(claim)(burn)(income)(claimfor)(setprofile)(setshare)(resetshare)(shareincome)/*(lock)(unlock)(refund)(lockresult)(unlockresult)(refundresult)*/(tax)/*(sublcd)*/ )
+EOSIO_DISPATCH( eosio::token, (create)(issue)(transfer)(transferclose)(transfermany)(open)(close)(retire)(claim)(burn)(income)(claimfor)(claimmany)(setprofile)(setprofhash)(setprofpart)(setnotify)(setlazy)(setaccrual)(payshares)(setquota)(viewbalance)(addholders)(settle)(rollup)(migrate)(loadaccounts)(loadshares)(loadpools)(loadprofiles)(loadsettings)(loadstat)(setshare)(resetshare)(shareincome)/*(lock)(unlock)(refund)(lockresult)(unlockresult)(refundresult)*/(tax)(events)(evpack)/*(sublcd)*/ )
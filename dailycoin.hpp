@@ -5,11 +5,21 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
 #include <eosio/transaction.hpp>
-#include <math.h>
 
+#include <algorithm>
+#include <cstring>
+#include <map>
 #include <string>
+#include <vector>
+
+// Packed events are sent in place of the batched "events" action.
+#if defined(DAILYCOIN_PACKED_EVENTS) && !defined(DAILYCOIN_BATCH_EVENTS)
+#define DAILYCOIN_BATCH_EVENTS
+#endif
 
 namespace eosiosystem {
    class system_contract;
@@ -18,6 +28,78 @@ namespace eosiosystem {
 namespace eosio {
 
    using std::string;
+   using std::vector;
+
+   // Fixed-point demurrage engine. It is in the header, like the token::get_balance() helpers that
+   //   use it, so that other contracts can call those without linking dailycoin.cpp.
+   namespace demurrage {
+
+      typedef unsigned __int128 uint128;
+
+      // Demurrage decay factors are unsigned fixed-point numbers with DEMURRAGE_FRACTION_BITS
+      //   fractional bits, so multiplying a balance by a factor is a widening multiply and a shift.
+      constexpr int      DEMURRAGE_FRACTION_BITS = 60;
+      constexpr uint64_t DEMURRAGE_FACTOR_ONE    = 1ull << DEMURRAGE_FRACTION_BITS;
+
+      // 0.995^(1/365), the decay factor for one day of the 0.5% per year demurrage tax.
+      constexpr uint64_t DEMURRAGE_DAY_FACTOR    = 1152905671654574793ull;
+
+      // 0.995, the decay factor for one year (365 days).
+      constexpr uint64_t DEMURRAGE_YEAR_FACTOR   = 1147156897083812741ull;
+
+      // Gaps of up to this many days are resolved with a single table lookup.
+      constexpr int64_t  DEMURRAGE_TABLE_DAYS    = 32;
+
+      // Multiplies two decay factors, rounding to nearest.
+      constexpr uint64_t mul_factor( uint64_t a, uint64_t b ) {
+         return (uint64_t)(((uint128)a * b + (DEMURRAGE_FACTOR_ONE >> 1)) >> DEMURRAGE_FRACTION_BITS);
+      }
+
+      // Raises a decay factor to a non-negative integer power by squaring.
+      constexpr uint64_t pow_factor( uint64_t base, uint64_t exp ) {
+         uint64_t result = DEMURRAGE_FACTOR_ONE;
+         while (exp > 0) {
+            if (exp & 1)
+               result = mul_factor( result, base );
+            base = mul_factor( base, base );
+            exp >>= 1;
+         }
+         return result;
+      }
+
+      // Decay factor for 0..DEMURRAGE_TABLE_DAYS days, computed at compile time.
+      struct demurrage_table {
+         uint64_t factor[DEMURRAGE_TABLE_DAYS + 1];
+
+         constexpr demurrage_table() : factor() {
+            factor[0] = DEMURRAGE_FACTOR_ONE;
+            for (int64_t d = 1; d <= DEMURRAGE_TABLE_DAYS; ++d)
+               factor[d] = mul_factor( factor[d - 1], DEMURRAGE_DAY_FACTOR );
+         }
+      };
+
+      inline constexpr demurrage_table demurrage_factors;
+
+      // Decay factor for any number of days: whole years use the exact yearly factor, the
+      //   remainder is split into table-sized chunks and a final table lookup.
+      constexpr uint64_t get_demurrage_factor( uint64_t days ) {
+         if (days <= DEMURRAGE_TABLE_DAYS)
+            return demurrage_factors.factor[days];
+         uint64_t f = demurrage_factors.factor[(days % 365) % DEMURRAGE_TABLE_DAYS];
+         f = mul_factor( f, pow_factor( demurrage_factors.factor[DEMURRAGE_TABLE_DAYS], (days % 365) / DEMURRAGE_TABLE_DAYS ) );
+         return mul_factor( f, pow_factor( DEMURRAGE_YEAR_FACTOR, days / 365 ) );
+      }
+
+      constexpr uint64_t factor_distance( uint64_t a, uint64_t b ) { return (a > b) ? a - b : b - a; }
+
+      // The two constants must describe the same tax: 365 days of the daily factor must come back
+      //   to the yearly one. Every rounded multiply is off by up to half a unit in the last place
+      //   (2^-60), so they can't match exactly, but they must stay within a few hundred units.
+      static_assert( factor_distance( pow_factor( DEMURRAGE_DAY_FACTOR, 365 ), DEMURRAGE_YEAR_FACTOR ) < 256,
+                     "daily and yearly demurrage factors don't agree" );
+      static_assert( factor_distance( get_demurrage_factor( 364 ), pow_factor( DEMURRAGE_DAY_FACTOR, 364 ) ) < 256,
+                     "table and chunked demurrage factors don't agree" );
+   } // namespace demurrage
 
    class [[eosio::contract("dailycoin")]] token : public contract {
    public:
@@ -35,6 +117,20 @@ namespace eosio {
       [[eosio::action]]
          void transfer( name from, name to, asset quantity, string  memo );
 
+      // Transfers the whole balance of "from" (after its demurrage tax, see viewbalance) and
+      //   closes the account, which is the same as a transfer followed by a close.
+      [[eosio::action]]
+         void transferclose( name from, name to, asset quantity, string memo );
+
+      // One receiver of a transfermany action.
+      struct payment {
+         name        to;
+         asset       quantity;
+      };
+
+      [[eosio::action]]
+         void transfermany( name from, vector<payment> payments, string memo );
+
       [[eosio::action]]
          void open( name owner, const symbol& symbol, name ram_payer );
 
@@ -47,6 +143,9 @@ namespace eosio {
       [[eosio::action]]
          void claimfor( name owner, name ram_payer ); // Implicit token symbol
 
+      [[eosio::action]]
+         void claimmany( vector<name> owners, name ram_payer ); // Implicit token symbol
+
       [[eosio::action]]
          void burn( name owner, asset quantity );
 
@@ -65,6 +164,135 @@ namespace eosio {
       [[eosio::action]]
          void setprofile( name owner, string profile ); // Implicit token symbol
 
+      // Stores only the sha256 hash and the size of the profile, which is left in the action data,
+      //   in place of the profile itself. The profile has the same 1024 byte limit as with
+      //   setprofile(). An empty profile removes it.
+      [[eosio::action]]
+         void setprofhash( name owner, string profile ); // Implicit token symbol
+
+      // Overwrites the stored profile from byte "offset" on with "data", growing it if needed.
+      [[eosio::action]]
+         void setprofpart( name owner, uint32_t offset, string data ); // Implicit token symbol
+
+      [[eosio::action]]
+         void setnotify( name owner, bool tax, bool income, bool shareincome, asset min_quantity );
+
+      [[eosio::action]]
+         void setlazy( name owner, bool lazy ); // Implicit token symbol
+
+      // In share accrual mode, the part of the owner's income that their shares are owed is kept in
+      //   their share pool instead of being paid to every share right away, and payshares() pays it.
+      [[eosio::action]]
+         void setaccrual( name owner, bool accrual ); // Implicit token symbol
+
+      // Pays the owner's share pool to their shares, as a claim would have, with any new balance
+      //   rows billed to "ram_payer". Anyone can call it, for instance a share recipient or a keeper.
+      // At most max_share_payouts shares are paid per call: the rest stays in the pool, and the
+      //   next call carries on where this one stopped.
+      [[eosio::action]]
+         void payshares( name owner, name ram_payer ); // Implicit token symbol
+
+      // Limits the accounts that "ram_payer" can pay new rows for with open, claimfor, claimmany and
+      //   payshares to "max_per_day" a day. An account counts once, whether it gets a balance row
+      //   and its holders row or a share pool. A max_per_day of 0 removes the limit.
+      [[eosio::action]]
+         void setquota( name ram_payer, uint32_t max_per_day );
+
+      // What an account holds right now, with the tax and income that its next settlement would add.
+      struct balance_view {
+         asset       balance;         // balance after the pending tax (same as get_balance())
+         asset       pending_tax;     // demurrage owed since the account was last settled
+         asset       claimable;       // income a claim would pay today, before income shares
+         uint32_t    next_claim_day;  // first day a claim pays any income
+      };
+
+      // Adds the accounts of "owners" that are missing from the holders table, which can be the case
+      //   for accounts that haven't been settled since the table was introduced.
+      [[eosio::action]]
+         void addholders( vector<name> owners, name ram_payer ); // Implicit token symbol
+
+      // Charges the demurrage tax owed by up to "max_accounts" of the accounts that have gone the
+      //   longest without being settled, without claiming their income. Anyone can call it.
+      [[eosio::action]]
+         void settle( uint32_t max_accounts ); // Implicit token symbol
+
+      // Folds the changes kept in the stats shards into the "stat" row (needs a contract built with
+      //   DAILYCOIN_SHARDED_STATS). Anyone can call it.
+      [[eosio::action]]
+         void rollup( const symbol_code& sym_code );
+
+      // Changes nothing; meant to be called in a read-only (or dry run) transaction.
+      [[eosio::action]]
+         balance_view viewbalance( name owner ); // Implicit token symbol
+
+      // Moves the accounts rows of "owners" to the compact holdings table (needs a contract built
+      //   with DAILYCOIN_COMPACT_ACCOUNTS). Owners that have no accounts row are skipped, so any
+      //   owner can be listed again, in any order, until it has been moved.
+      [[eosio::action]]
+         void migrate( vector<name> owners ); // Implicit token symbol
+
+      // Snapshot rows, as read from the accounts (or holdings), shares, share pools, profiles and
+      //   settings tables. A snapshot is a sequence of loadaccounts, loadshares, loadpools,
+      //   loadprofiles, loadsettings and loadstat actions, so its serialized form is the action
+      //   data of those actions.
+      struct snapshot_account {
+         name        owner;
+         int64_t     amount;
+         uint32_t    last_claim_day;
+         uint32_t    last_settle_day; // 0 if the row has none
+         bool        lazy;
+      };
+
+      struct snapshot_share {
+         name        owner;
+         name        to;
+         uint8_t     percent;
+      };
+
+      struct snapshot_pool {
+         name        owner;
+         int64_t     amount;
+         int64_t     round_amount;
+         int64_t     round_left;
+         uint8_t     round_percent;
+         name        next_to;
+      };
+
+      struct snapshot_profile {
+         name        owner;
+         string      profile;
+      };
+
+      struct snapshot_setting {
+         name        owner;
+         uint32_t    flags;
+         int64_t     min_notify_amount;
+      };
+
+      // Bulk load of a snapshot into a fresh deployment (needs a contract built with
+      //   DAILYCOIN_RESTORE). The token must have been created, every row must be new, and every
+      //   owner (and share recipient) must be an account. The loaded balances are added to the
+      //   supply, and so is what the loaded share pools owe. loadstat restores the burned and
+      //   claims totals.
+      [[eosio::action]]
+         void loadaccounts( const symbol& symbol, vector<snapshot_account> rows );
+
+      [[eosio::action]]
+         void loadshares( vector<snapshot_share> rows );
+
+      // The shares of each pool owner have to be loaded first.
+      [[eosio::action]]
+         void loadpools( vector<snapshot_pool> rows );
+
+      [[eosio::action]]
+         void loadprofiles( vector<snapshot_profile> rows );
+
+      [[eosio::action]]
+         void loadsettings( vector<snapshot_setting> rows );
+
+      [[eosio::action]]
+         void loadstat( const symbol_code& sym_code, asset burned, uint64_t claims );
+
       // This implementation is incompatible with demurrage.
       // Also, it might just be security overkill.
       //
@@ -129,34 +357,182 @@ namespace eosio {
           asset     quantity;
       };
 
+      // One tax, income or shareincome notification inside a batched "events" action.
+      struct event_abi {
+         uint8_t     type;            // EVENT_TAX, EVENT_INCOME or EVENT_SHAREINCOME
+         name        owner;           // taxed account, income claimant or share giver
+         name        to;              // share receiver (shareincome only)
+         asset       quantity;
+         uint8_t     percent;         // share percent (shareincome only)
+         uint32_t    next_claim_day;  // day income can be claimed next (income only)
+         uint32_t    lost_days;       // days of income lost to the claim cap (income only)
+      };
+
+      static const uint8_t EVENT_TAX = 1;
+      static const uint8_t EVENT_INCOME = 2;
+      static const uint8_t EVENT_SHAREINCOME = 3;
+
+      // When the contract is compiled with DAILYCOIN_BATCH_EVENTS, all the events of an action
+      //   are sent in one "events" inline action instead of one tax, income or shareincome each.
+      [[eosio::action]]
+         void events( vector<event_abi> events );
+
+      // Packed event stream, sent as the data of a single "evpack" action instead of "events" when
+      //   the contract is compiled with DAILYCOIN_PACKED_EVENTS. All values are little-endian.
+      //
+      //   header:       version (u8), symbol (u64), base day (u32, as get_today())
+      //   every event:  type (u8), owner (u64), amount (i64), then by type:
+      //     EVENT_TAX          nothing else                                         17 bytes
+      //     EVENT_INCOME       next claim day - base day (i16), lost days (u32)     23 bytes
+      //     EVENT_SHAREINCOME  receiver (u64), percent (u8)                         26 bytes
+      static constexpr uint8_t EVENT_PACK_VERSION = 1;
+      static constexpr size_t EVENT_PACK_HEADER_SIZE = 13;
+
+      [[eosio::action]]
+         void evpack( vector<char> data );
+
+      // One event read back from a packed event stream.
+      struct packed_event {
+         uint8_t     type = 0;
+         uint64_t    owner = 0;
+         int64_t     amount = 0;
+         uint64_t    to = 0;              // shareincome only
+         uint8_t     percent = 0;         // shareincome only
+         uint32_t    next_claim_day = 0;  // income only
+         uint32_t    lost_days = 0;       // income only
+      };
+
+      // Reference decoder for packed event streams. It only reads the buffer, so it can be used
+      //   by off-chain indexers as well as by the contract.
+      struct packed_event_reader {
+         const char*  p;
+         const char*  end;
+         bool         valid = false;  // the header was read and has a known version
+         uint64_t     symbol_raw = 0;
+         uint32_t     base_day = 0;
+
+         packed_event_reader( const char* data, size_t size ) : p(data), end(data + size)
+         {
+            uint8_t version = 0;
+            valid = read( version ) && (version == EVENT_PACK_VERSION) && read( symbol_raw ) && read( base_day );
+         }
+
+         // Reads the next event. Returns false at the end of the stream or if it is malformed.
+         bool next( packed_event& e )
+         {
+            if( !valid || p == end )
+               return false;
+            e = packed_event{};
+            if( !read( e.type ) || !read( e.owner ) || !read( e.amount ) )
+               return valid = false;
+            if( e.type == EVENT_INCOME ) {
+               int16_t day_delta;
+               if( !read( day_delta ) || !read( e.lost_days ) )
+                  return valid = false;
+               e.next_claim_day = base_day + day_delta;
+            } else if( e.type == EVENT_SHAREINCOME ) {
+               if( !read( e.to ) || !read( e.percent ) )
+                  return valid = false;
+            } else if( e.type != EVENT_TAX ) {
+               return valid = false;
+            }
+            return true;
+         }
+
+         template<typename T>
+         bool read( T& v )
+         {
+            if( size_t(end - p) < sizeof(T) )
+               return false;
+            memcpy( &v, p, sizeof(T) );
+            p += sizeof(T);
+            return true;
+         }
+      };
+
       static asset get_supply( name token_contract_account, symbol_code sym_code )
       {
          stats statstable( token_contract_account, sym_code.raw() );
          const auto& st = statstable.get( sym_code.raw() );
+#ifdef DAILYCOIN_SHARDED_STATS
+         asset supply = st.supply;
+         stats_shards shards( token_contract_account, sym_code.raw() );
+         for ( const auto& sh : shards )
+            supply.amount += sh.supply_delta;
+         return supply;
+#else
          return st.supply;
+#endif
       }
 
+      // The balance after the demurrage tax that it owes today, which is only charged from the
+      //   row when the account is settled.
       static asset get_balance( name token_contract_account, name owner, symbol_code sym_code )
       {
-         accounts accountstable( token_contract_account, owner.value );
-         const auto& ac = accountstable.get( sym_code.raw() );
-         return ac.balance;
+         const account ac = read_account( token_contract_account, owner, sym_code );
+         int64_t days = get_unsettled_days( ac.last_claim_day, ac.last_settle_day.value_or( 0 ), get_today() );
+         return asset{ ac.balance.amount - get_demurrage_tax( ac.balance.amount, days ), ac.balance.symbol };
+      }
+
+      static balance_view get_balance_view( name token_contract_account, name owner, symbol_code sym_code )
+      {
+         const account ac = read_account( token_contract_account, owner, sym_code );
+         stats statstable( token_contract_account, sym_code.raw() );
+         const auto& st = statstable.get( sym_code.raw(), "symbol does not exist" );
+
+         const time_type today = get_today();
+         int64_t days = get_unsettled_days( ac.last_claim_day, ac.last_settle_day.value_or( 0 ), today );
+         int64_t tax = get_demurrage_tax( ac.balance.amount, days );
+
+         // Same max_supply limit as settle_claim().
+         int64_t claim = get_ubi_claim( ac.last_claim_day, today ).amount;
+         int64_t available = st.max_supply.amount - get_supply( token_contract_account, sym_code ).amount;
+         if (claim > available)
+            claim = (available > 0) ? available : 0;
+
+         return balance_view{
+            asset{ ac.balance.amount - tax, ac.balance.symbol },
+            asset{ tax, ac.balance.symbol },
+            asset{ claim, ac.balance.symbol },
+            (claim > 0) ? today : today + 1
+         };
       }
 
       using create_action = eosio::action_wrapper<"create"_n, &token::create>;
       using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
       using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
       using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+      using transferclose_action = eosio::action_wrapper<"transferclose"_n, &token::transferclose>;
+      using transfermany_action = eosio::action_wrapper<"transfermany"_n, &token::transfermany>;
       using open_action = eosio::action_wrapper<"open"_n, &token::open>;
       using close_action = eosio::action_wrapper<"close"_n, &token::close>;
       using claim_action = eosio::action_wrapper<"claim"_n, &token::claim>;
       using claimfor_action = eosio::action_wrapper<"claimfor"_n, &token::claimfor>;
+      using claimmany_action = eosio::action_wrapper<"claimmany"_n, &token::claimmany>;
       using burn_action = eosio::action_wrapper<"burn"_n, &token::burn>;
       using income_action = eosio::action_wrapper<"income"_n, &token::income>;
       using setshare_action = eosio::action_wrapper<"setshare"_n, &token::setshare>;
       using resetshare_action = eosio::action_wrapper<"resetshare"_n, &token::resetshare>;
       using shareincome_action = eosio::action_wrapper<"shareincome"_n, &token::shareincome>;
       using setprofile_action = eosio::action_wrapper<"setprofile"_n, &token::setprofile>;
+      using setprofhash_action = eosio::action_wrapper<"setprofhash"_n, &token::setprofhash>;
+      using setprofpart_action = eosio::action_wrapper<"setprofpart"_n, &token::setprofpart>;
+      using setnotify_action = eosio::action_wrapper<"setnotify"_n, &token::setnotify>;
+      using setlazy_action = eosio::action_wrapper<"setlazy"_n, &token::setlazy>;
+      using setaccrual_action = eosio::action_wrapper<"setaccrual"_n, &token::setaccrual>;
+      using payshares_action = eosio::action_wrapper<"payshares"_n, &token::payshares>;
+      using setquota_action = eosio::action_wrapper<"setquota"_n, &token::setquota>;
+      using viewbalance_action = eosio::action_wrapper<"viewbalance"_n, &token::viewbalance>;
+      using addholders_action = eosio::action_wrapper<"addholders"_n, &token::addholders>;
+      using settle_action = eosio::action_wrapper<"settle"_n, &token::settle>;
+      using rollup_action = eosio::action_wrapper<"rollup"_n, &token::rollup>;
+      using migrate_action = eosio::action_wrapper<"migrate"_n, &token::migrate>;
+      using loadaccounts_action = eosio::action_wrapper<"loadaccounts"_n, &token::loadaccounts>;
+      using loadshares_action = eosio::action_wrapper<"loadshares"_n, &token::loadshares>;
+      using loadpools_action = eosio::action_wrapper<"loadpools"_n, &token::loadpools>;
+      using loadprofiles_action = eosio::action_wrapper<"loadprofiles"_n, &token::loadprofiles>;
+      using loadsettings_action = eosio::action_wrapper<"loadsettings"_n, &token::loadsettings>;
+      using loadstat_action = eosio::action_wrapper<"loadstat"_n, &token::loadstat>;
       //using lock_action = eosio::action_wrapper<"lock"_n, &token::lock>;
       //using unlock_action = eosio::action_wrapper<"unlock"_n, &token::unlock>;
       //using refund_action = eosio::action_wrapper<"refund"_n, &token::refund>;
@@ -164,6 +540,8 @@ namespace eosio {
       //using unlockresult_action = eosio::action_wrapper<"unlockresult"_n, &token::unlockresult>;
       //using refundresult_action = eosio::action_wrapper<"refundresult"_n, &token::refundresult>;
       using tax_action = eosio::action_wrapper<"tax"_n, &token::tax>;
+      using evpack_action = eosio::action_wrapper<"evpack"_n, &token::evpack>;
+      using events_action = eosio::action_wrapper<"events"_n, &token::events>;
 
       // Debug helper action
       //using sublcd_action = eosio::action_wrapper<"sublcd"_n, &token::sublcd>;
@@ -183,6 +561,12 @@ namespace eosio {
          asset       balance;
          time_type   last_claim_day;
 
+         // The last day the demurrage tax was charged, for accounts in lazy settlement mode (see
+         //   setlazy()), when that can be later than last_claim_day. Rows that don't have it and were
+         //   taxed by a settle() sweep have that day as the last_day of their holders row instead.
+         binary_extension<time_type> last_settle_day;
+         binary_extension<bool>      lazy_settlement;
+
          uint64_t primary_key()const { return balance.symbol.code().raw(); }
       };
 
@@ -203,12 +587,69 @@ namespace eosio {
          uint64_t primary_key()const { return to.value; }
       };
 
+      // Sum of the share percents of an owner and the number of share rows they have, kept up
+      //   to date by setshare() and resetshare(). Owners that set shares before this table existed
+      //   have no row until their next setshare().
+      struct [[eosio::table]] share_total {
+         uint8_t  percent;
+         uint32_t count;
+
+         uint64_t primary_key()const { return 0; } // singleton
+      };
+
+      // Income of an owner in share accrual mode (see setaccrual()) that is owed to their shares and
+      //   not paid yet, in COIN_SYMBOL units. Their shares can't be changed while it isn't empty.
+      //   payshares() takes "amount" as a new payout, and a payout that reaches max_share_payouts
+      //   before all the shares are paid resumes at "next_to" on the next call.
+      struct [[eosio::table]] share_pool {
+         int64_t  amount;         // owed to the shares in proportion to their percents
+         int64_t  round_amount;   // payout in progress, if any
+         int64_t  round_left;     // what is still to be paid of it
+         uint8_t  round_percent;  // share percents it was paid to so far
+         name     next_to;        // share the payout resumes at
+
+         uint64_t primary_key()const { return 0; } // singleton
+      };
+
       struct [[eosio::table]] profile {
          string   profile;
 
          uint64_t primary_key()const { return 0; } // singleton
       };
 
+      // A profile kept off the contract's RAM (see setprofhash()). An owner has either this row or
+      //   a profiles row, not both.
+      struct [[eosio::table]] profile_hash {
+         checksum256 hash;  // sha256 of the profile
+         uint32_t    size;  // profile size in bytes
+
+         uint64_t primary_key()const { return 0; } // singleton
+      };
+
+      // Per-account options. An account without a row uses all the defaults (all flags off).
+      struct [[eosio::table]] setting {
+         uint32_t flags;
+         int64_t  min_notify_amount; // tax, income and shareincome events below this are not sent
+
+         uint64_t primary_key()const { return 0; } // singleton
+      };
+
+      // Limit set by a RAM payer with setquota(), in its own scope. A payer without a row has
+      //   no limit.
+      struct [[eosio::table]] payer_quota {
+         uint32_t    max_per_day;
+         uint32_t    available;    // accounts that can still be paid for on "day"
+         time_type   day;
+
+         uint64_t primary_key()const { return 0; } // singleton
+      };
+
+      static const uint32_t MUTE_TAX = 0x1;
+      static const uint32_t MUTE_INCOME = 0x2;
+      static const uint32_t MUTE_SHAREINCOME = 0x4;
+      static const uint32_t MUTE_ALL = MUTE_TAX | MUTE_INCOME | MUTE_SHAREINCOME;
+      static const uint32_t SHARE_ACCRUAL = 0x8;
+
       //struct [[eosio::table]] locker {
       //   asset    balance;
       //   uint64_t primary_key()const { return balance.symbol.code().raw(); }
@@ -220,19 +661,252 @@ namespace eosio {
       //   int64_t primary_key()const { return balance.symbol.code().raw(); }
       //};
 
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      // Compact COIN_SYMBOL balance row. The symbol is implied, so only the amount is stored,
+      //   and there is one row per owner scope, with primary key 0.
+      struct [[eosio::table]] holding {
+         int64_t     amount;
+         time_type   last_claim_day;
+         binary_extension<time_type> last_settle_day; // as in account
+         binary_extension<bool>      lazy_settlement;
+
+         uint64_t primary_key()const { return 0; }
+      };
+
+      // Progress of the accounts to holdings migration (see migrate()), in the contract's scope.
+      struct [[eosio::table]] migration {
+         name        last_owner;  // highest owner moved so far, to show how far a scan has got
+         uint64_t    rows;        // accounts rows moved so far
+
+         uint64_t primary_key()const { return 0; } // singleton
+      };
+#endif
+
+      // One row per holder of COIN_SYMBOL, in the contract's scope, so that dormant accounts can
+      //   be range-scanned by the day they were last settled instead of going through every scope.
+      struct [[eosio::table]] holder {
+         name        owner;
+         time_type   last_day;   // the later of the account's last_claim_day and last_settle_day
+
+         uint64_t primary_key()const { return owner.value; }
+         uint64_t by_last_day()const { return last_day; }
+      };
+
+#ifdef DAILYCOIN_DAY_STATS
+      // Claims, income and tax of one day, in the symbol code's scope. Only the last
+      //   day_stats_window days are kept.
+      struct [[eosio::table]] day_stat {
+         time_type   day;
+         uint64_t    claims;   // income claims, which is also the number of accounts that claimed
+         int64_t     income;   // income issued, in token units
+         int64_t     tax;      // demurrage tax burned, in token units
+
+         uint64_t primary_key()const { return day; }
+      };
+#endif
+
+#ifdef DAILYCOIN_SHARDED_STATS
+      // Supply, burned and claims changes that are not in the "stat" row yet (see rollup()), in the
+      //   symbol code's scope. Each action writes to the shard of one of its accounts, so that
+      //   concurrent actions don't all write to the same row.
+      struct [[eosio::table]] stats_shard {
+         uint64_t    id;
+         int64_t     supply_delta;
+         int64_t     burned_delta;
+         uint64_t    claims_delta;
+
+         uint64_t primary_key()const { return id; }
+      };
+#endif
+
       typedef eosio::multi_index< "accounts"_n, account > accounts;
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      typedef eosio::multi_index< "holdings"_n, holding > holdings;
+      typedef eosio::multi_index< "migrations"_n, migration > migrations;
+#endif
       typedef eosio::multi_index< "stat"_n, currency_stats > stats;
+#ifdef DAILYCOIN_SHARDED_STATS
+      typedef eosio::multi_index< "statshards"_n, stats_shard > stats_shards;
+#endif
+#ifdef DAILYCOIN_DAY_STATS
+      typedef eosio::multi_index< "daystats"_n, day_stat > day_stats;
+#endif
       typedef eosio::multi_index< "shares"_n, share > shares;
+      typedef eosio::multi_index< "sharetotals"_n, share_total > sharetotals;
+      typedef eosio::multi_index< "sharepools"_n, share_pool > sharepools;
       typedef eosio::multi_index< "profiles"_n, profile > profiles;
+      typedef eosio::multi_index< "profhashes"_n, profile_hash > profhashes;
+      typedef eosio::multi_index< "settings"_n, setting > settings;
+      typedef eosio::multi_index< "payerquotas"_n, payer_quota > payerquotas;
+      typedef eosio::multi_index< "holders"_n, holder,
+         indexed_by< "bylastday"_n, const_mem_fun<holder, uint64_t, &holder::by_last_day> > > holders;
       //typedef eosio::multi_index< "lockers"_n, locker > lockers;
       //typedef eosio::multi_index< "unlockers"_n, unlocker > unlockers;
 
-      void sub_balance( name owner, asset value );
-      void add_balance( name owner, asset value, name ram_payer );
+      // Collects the supply, burned and claims changes made by an action so that the "stat" row
+      //   is modified once, by flush(), instead of once per tax, claim, issue, retire or burn.
+      // With DAILYCOIN_SHARDED_STATS, flush() writes to a stats shard instead.
+      // Every action that can settle an account has one, so it also keeps the day of the action,
+      //   and the clock is read once per action rather than once per settled account.
+      struct stats_accumulator {
+         stats                  statstable;
+         const currency_stats&  st;
+         const time_type        today;
+         int64_t                supply_delta = 0;
+         int64_t                burned_delta = 0;
+         uint64_t               claims_delta = 0;
+         name                   shard_owner;     // account whose stats shard flush() writes to
+#ifdef DAILYCOIN_DAY_STATS
+         int64_t                income_delta = 0;
+         int64_t                tax_delta = 0;
+#endif
+#ifdef DAILYCOIN_SHARDED_STATS
+         mutable bool           shards_loaded = false;
+         mutable int64_t        shards_supply = 0;
+#endif
+
+         stats_accumulator( name code, symbol_code sym_code, const char* error_msg );
+
+         int64_t get_supply()const;
+
+         // With DAILYCOIN_MULTI_TOKEN, checks "sym" against the precision of the token. Otherwise
+         //   token_symbol() has already compared it with COIN_SYMBOL.
+         void check_symbol( const symbol& sym )const
+         {
+#ifdef DAILYCOIN_MULTI_TOKEN
+            check( sym == st.supply.symbol, "symbol precision mismatch" );
+#else
+            (void)sym;
+#endif
+         }
+
+         void add_supply( int64_t amount ) { supply_delta += amount; }
+         void add_burned( int64_t amount ) { supply_delta -= amount; burned_delta += amount; }
+#ifdef DAILYCOIN_DAY_STATS
+         void add_tax( int64_t amount ) { add_burned( amount ); tax_delta += amount; }
+         void add_claim( int64_t amount ) { supply_delta += amount; ++claims_delta; income_delta += amount; }
+#else
+         void add_tax( int64_t amount ) { add_burned( amount ); }
+         void add_claim( int64_t amount ) { supply_delta += amount; ++claims_delta; }
+#endif
+
+         void flush();
+#ifdef DAILYCOIN_DAY_STATS
+         void flush_day();
+#endif
+      };
+
+      // An accounts row that is read once per owner per action. Tax, claim and transfer amounts
+      //   are applied to this copy, and commit() writes it back with a single modify or emplace.
+      // With DAILYCOIN_COMPACT_ACCOUNTS, a COIN_SYMBOL balance is read from the holdings row if
+      //   there is one and from accounts otherwise, and new COIN_SYMBOL rows go to holdings.
+      struct account_handle {
+         accounts                  acnts;
+         accounts::const_iterator  it;
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+         holdings                  holds;
+         holdings::const_iterator  hit;
+         bool                      compact = false; // row is (or will be) in holdings
+#endif
+         asset                     balance;
+         time_type                 last_claim_day = 0;
+         name                      payer;           // RAM payer for the final write
+         bool                      exists = false;  // row is in the table, or will be emplaced
+         bool                      created = false; // row will be emplaced by commit()
+         bool                      dirty = false;
+         bool                      lazy = false;    // lazy settlement mode
+         time_type                 last_settle_day = 0;
+         bool                      has_settle_day = false; // row has a last_settle_day
+         time_type                 tracked_day = 0; // last_day in the holders table, as read
+         bool                      settled = false; // tax and UBI already resolved in this action
+         bool                      setting_loaded = false;
+         uint32_t                  flags = 0;
+         int64_t                   min_notify_amount = 0;
+         bool                      sponsored = false; // counted against the sponsor's quota
+
+         account_handle( name code, name owner, const symbol& sym );
+
+         void create( name ram_payer );
+         void commit();
+         void erase();
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+         bool migrate( name ram_payer );
+#endif
+
+         void load_setting();
+         bool wants_notify( uint32_t mute_flag, int64_t amount );
+
+         time_type last_day()const { return (last_settle_day > last_claim_day) ? last_settle_day : last_claim_day; }
+
+         // Writes the claim and settlement days to an accounts or holdings row. A row only gets a
+         //   last_settle_day when it goes into lazy settlement mode, and, once it has one, keeps it.
+         //   Otherwise a last_settle_day later than the last_claim_day is kept in the holders row.
+         template<typename Row>
+         void write_days( Row& r )
+         {
+            r.last_claim_day = last_claim_day;
+            if( has_settle_day || lazy ) {
+               r.last_settle_day.emplace( last_settle_day );
+               has_settle_day = true;
+            }
+            if( lazy )
+               r.lazy_settlement.emplace( true );
+            else
+               r.lazy_settlement.reset();
+         }
+      };
+
+      // The account_handle of every owner touched by an action. commit() also keeps the holders
+      //   table up to date, which only needs a write when an account's last_day moves.
+      struct account_cache {
+         name                                code;
+         symbol                              sym;
+         std::map<uint64_t, account_handle>  handles;
+         uint32_t                            share_payouts = 0;      // cascaded share payouts so far
+         name                                sponsor;                // payer whose rows for others are counted
+         uint32_t                            sponsored_accounts = 0; // accounts with rows billed to the sponsor
+         holders                             holderstable;
+
+         account_cache( name code, const symbol& sym ) : code(code), sym(sym), holderstable(code, code.value) {}
+
+         account_handle& get( name owner );
+         void commit();
+         void erase( name owner );
+         void track( name owner, account_handle& acct, name ram_payer );
+         void bill( name owner, account_handle& acct, name ram_payer );
+      };
+
+      void sub_balance( account_cache& accts, name owner, asset value );
+      void add_balance( account_cache& accts, name owner, asset value, name ram_payer );
+
+      void use_payer_quota( name ram_payer, uint32_t new_accounts, time_type today );
 
       //void try_refund( name owner, name payer, bool fail );
 
-      void try_ubi_claim( name from, const symbol& sym, name payer, stats& statstable, const currency_stats& st, bool fail );
+      void try_ubi_claim( name from, const symbol& sym, name payer, stats_accumulator& stacc, account_cache& accts, bool fail, bool receiving );
+
+      // Income to be paid to the shares of "giver": a claimed income (percent 100) or a share pool
+      //   (percent of its share total).
+      struct share_payment {
+         name        giver;
+         int64_t     amount;
+         uint8_t     percent;  // share percent total that "amount" is for
+         bool        pooled;   // already taken from the share pool
+
+         // Where a pooled payment resumes, and where it stopped once pay_shares() returns. It
+         //   was paid in full if nothing is left.
+         int64_t     left = 0;
+         uint8_t     paid_percent = 0;
+         name        next_to;
+      };
+
+      void pay_shares( vector<share_payment>& pending, const symbol& sym, name payer, stats_accumulator& stacc, account_cache& accts );
+
+      bool accrue_shares( name giver, account_handle& giver_account, int64_t amount, const symbol& sym, name payer, account_cache& accts );
+
+      asset settle_claim( name from, const symbol& sym, stats_accumulator& stacc, account_cache& accts, bool fail, bool receiving );
+
+      void settle_tax( name owner, account_handle& acct, stats_accumulator& stacc, time_type today );
 
       //void log_lock( name owner, asset locker_balance, asset unlocker_balance, asset token_delta );
 
@@ -246,7 +920,155 @@ namespace eosio {
 
       void log_share( name giver, name receiver, asset share_quantity, uint8_t share_percent );
 
-      static string days_to_string( int64_t days );
+      // "today" is the day of the action, written to the header of a packed event stream.
+      void send_events( time_type today );
+
+#ifdef DAILYCOIN_INSTRUMENT
+      // Database and inline action calls made by the action on the transfer and claim paths,
+      //   counted by DAILYCOIN_COUNT() and printed by perf_report() when the action ends.
+      struct perf_counters {
+         uint32_t    finds = 0;
+         uint32_t    modifies = 0;
+         uint32_t    emplaces = 0;
+         uint32_t    erases = 0;
+         uint32_t    nexts = 0;          // rows visited by iterating shares and stats shards
+         uint32_t    sends = 0;          // inline actions sent
+         uint32_t    share_payouts = 0;
+      };
+
+      static perf_counters perf;
+
+      void perf_report();
+#endif
+
+#ifdef DAILYCOIN_BATCH_EVENTS
+      vector<event_abi> pending_events;
+#endif
+
+      // Computes the demurrage tax owed by "balance" after "days" days, without floating point.
+      // This replaced balance - (int64_t)(pow(0.995, days / 365.0) * balance). Both round the kept
+      //   balance down and the fixed-point factors are accurate to about 1e-17, so for balances of
+      //   up to 10^9 XDL the result is the same or differs by one unit (0.0001 XDL). Past that the
+      //   double version was itself losing precision, and this one is the more accurate of the two.
+      static int64_t get_demurrage_tax( int64_t balance, int64_t days )
+      {
+         if (balance <= 0 || days <= 0)
+            return 0;
+         demurrage::uint128 kept = ((demurrage::uint128)balance * demurrage::get_demurrage_factor( days )) >> demurrage::DEMURRAGE_FRACTION_BITS;
+         return balance - (int64_t)kept;
+      }
+
+      // The symbol of the token an action works on. Unless the contract is built with
+      //   DAILYCOIN_MULTI_TOKEN, COIN_SYMBOL is the only token: anything else is rejected with one
+      //   comparison, and the scopes and keys that follow are compile-time constants.
+#ifdef DAILYCOIN_MULTI_TOKEN
+      static symbol token_symbol( const symbol& sym )
+      {
+         check( sym.is_valid(), "invalid symbol name" );
+         return sym;
+      }
+#else
+      static symbol token_symbol( const symbol& sym )
+      {
+         check( sym == COIN_SYMBOL, "unsupported symbol" );
+         return COIN_SYMBOL;
+      }
+#endif
+
+      // Reads the owner's balance row from whichever layout it is stored in, with the day of its
+      //   last settle() sweep as its last_settle_day if the row has none (see account_cache::get()).
+      static account read_account( name token_contract_account, name owner, symbol_code sym_code )
+      {
+         account ac = read_account_row( token_contract_account, owner, sym_code );
+         if( !ac.last_settle_day.has_value() && !ac.lazy_settlement.value_or( false ) && sym_code == COIN_SYMBOL.code() ) {
+            holders holderstable( token_contract_account, token_contract_account.value );
+            auto it = holderstable.find( owner.value );
+            if( it != holderstable.end() && it->last_day > ac.last_claim_day )
+               ac.last_settle_day.emplace( it->last_day );
+         }
+         return ac;
+      }
+
+      static account read_account_row( name token_contract_account, name owner, symbol_code sym_code )
+      {
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+         if( sym_code == COIN_SYMBOL.code() ) {
+            holdings holdingstable( token_contract_account, owner.value );
+            auto hit = holdingstable.find( 0 );
+            if( hit != holdingstable.end() )
+               return account{ asset{hit->amount, COIN_SYMBOL}, hit->last_claim_day, hit->last_settle_day, hit->lazy_settlement };
+         }
+#endif
+         accounts accountstable( token_contract_account, owner.value );
+         return accountstable.get( sym_code.raw(), "no balance object found" );
+      }
+
+      struct ubi_claim {
+         int64_t     amount;     // income in token units, before the max_supply limit
+         time_type   from_day;   // last_claim_day it is counted from (yesterday for a first claim)
+         time_type   lost_days;  // days of income lost to the claim cap
+      };
+
+      // Works out the income that a claim on "today" pays to an account that last claimed on
+      //   "last_claim_day", before the max_supply limit. Shared by settle_claim() and the views.
+      static ubi_claim get_ubi_claim( time_type last_claim_day, time_type today )
+      {
+         if (last_claim_day >= today)
+            return ubi_claim{ 0, last_claim_day, 0 };
+
+         time_type curr_lcd = last_claim_day;
+
+         // NEW: Removed the reward period logic, as it is incompatible with the demurrage code.
+         //
+         // If we are NOT in the reward period, then a last_claim_day of zero means YESTERDAY,
+         //   that is, you get ONE token when you successfully claim for the first time today
+         //   in a verified account.
+         // Otherwise it means the user is entitled to an additional bonus which is the number
+         //   of days until the bonus deadline. We force the bonus by emulating a "last claim
+         //   date" value pushed into the past as needed (capped at max_past_claim_days).
+         if (curr_lcd == 0) {
+           curr_lcd = today - 1;
+           //if (today <= last_signup_reward_day) {
+           //  int64_t bonus_days = last_signup_reward_day - today + 1;
+           //  if (bonus_days > max_past_claim_days) {
+           //    bonus_days = max_past_claim_days;
+           //  }
+           //  curr_lcd -= bonus_days;
+           //}
+         }
+
+         // The UBI grants 1 token per day per account.
+         // The 0.5% per year demurrage tax is not applied to accumulated UBI income, because the difference
+         //   is negligible. Can be interpreted as a pseudo-staking bonus for "locking" the tokens for 1 yr.
+
+         // Compute the claim amount relative to days elapsed since the last claim, excluding today's pay.
+         // If you claimed yesterday, this is zero.
+         int64_t claim_amount = today - curr_lcd - 1;
+
+         // The limit for claiming accumulated past income is 360 days/coins. Unclaimed tokens past that
+         //   one year maximum of accumulation are lost.
+         time_type lost_days = 0;
+         if (claim_amount > max_past_claim_days) {
+            lost_days = claim_amount - max_past_claim_days;
+            claim_amount = max_past_claim_days;
+         }
+
+         // Claim for one day.
+         claim_amount += 1;
+
+         return ubi_claim{ claim_amount * PRECISION_MULTIPLIER, curr_lcd, lost_days };
+      }
+
+      // Days of demurrage tax owed today, counted from the last day the account was settled.
+      static int64_t get_unsettled_days( time_type last_claim_day, time_type last_settle_day, time_type today )
+      {
+         time_type day = (last_settle_day > last_claim_day) ? last_settle_day : last_claim_day;
+         if (day == 0)
+            return 1; // never settled: charged for one day, like a first claim
+         return (day < today) ? today - day : 0;
+      }
+
+      static char* write_date( char* p, int64_t days );
 
       static time_type get_today() { return (time_type)(current_time_point().time_since_epoch().count() / 86400000000ll); }
 
@@ -254,6 +1076,44 @@ namespace eosio {
 
       static const int64_t max_past_claim_days = 360;
 
+      static const uint32_t max_profile_size = 1024;
+
+#ifdef DAILYCOIN_DAY_STATS
+#ifdef DAILYCOIN_DAY_STATS_WINDOW
+      static const time_type day_stats_window = DAILYCOIN_DAY_STATS_WINDOW;
+#else
+      static const time_type day_stats_window = 90;
+#endif
+#endif
+
+#ifdef DAILYCOIN_SHARDED_STATS
+#ifdef DAILYCOIN_STATS_SHARDS
+      static const uint64_t stats_shard_count = DAILYCOIN_STATS_SHARDS;
+#else
+      static const uint64_t stats_shard_count = 16;
+#endif
+
+      // Mixes the high bits of the name into the low ones, which are all zero for short names.
+      static uint64_t get_stats_shard( name owner )
+      {
+         uint64_t h = owner.value;
+         h ^= h >> 33;
+         h *= 0xff51afd7ed558ccdull;
+         h ^= h >> 33;
+         return h % stats_shard_count;
+      }
+#endif
+
+      // Most payouts made by a single action to the shares of share recipients, over the whole
+      //   cascade, and to the shares of a share pool (see pay_shares()). The direct shares of a
+      //   claimant don't count.
+#ifdef DAILYCOIN_MAX_SHARE_PAYOUTS
+      static const uint32_t max_share_payouts = DAILYCOIN_MAX_SHARE_PAYOUTS;
+#else
+      static const uint32_t max_share_payouts = 50;
+#endif
+      static_assert( max_share_payouts > 0, "payshares() must be able to pay at least one share" );
+
       //static const time_type last_signup_reward_day = 18871; // September 1st, 2021
    };
 
@@ -0,0 +1,705 @@
+/**
+ *  Behavior of the actions, one case per action or feature. The same cases are built against
+ *  every set of build options in CMakeLists.txt, so where an option changes what an action does
+ *  (or whether it is enabled at all), the case checks what that build should do.
+ */
+#include "harness.hpp"
+
+#include <cstdio>
+#include <map>
+
+using namespace dailycoin_test;
+
+namespace {
+
+   const name issuer = "issuer"_n;
+   const name alice  = "alice"_n;
+   const name bob    = "bob"_n;
+   const name carol  = "carol"_n;
+   const name dave   = "dave"_n;
+   const name erin   = "erin"_n;
+   const name faucet = "faucet"_n;
+
+#ifdef DAILYCOIN_MAX_SHARE_PAYOUTS
+   const uint32_t max_share_payouts = DAILYCOIN_MAX_SHARE_PAYOUTS;
+#else
+   const uint32_t max_share_payouts = 50;
+#endif
+
+   int failures = 0;
+
+   bool expect( bool ok, const char* what, int line ) {
+      if( !ok ) {
+         std::fprintf( stderr, "actions.cpp:%d: failed: %s\n", line, what );
+         ++failures;
+      }
+      return ok;
+   }
+
+   void expect_ok( const action_result& r, int line ) {
+      if( !r.ok ) {
+         std::fprintf( stderr, "actions.cpp:%d: action failed: %s\n", line, r.error.c_str() );
+         ++failures;
+      }
+   }
+
+   void expect_error( const action_result& r, const std::string& error, int line ) {
+      if( r.ok || r.error != error ) {
+         std::fprintf( stderr, "actions.cpp:%d: expected \"%s\", got %s%s\n", line, error.c_str(),
+                       r.ok ? "success" : "", r.ok ? "" : ("\"" + r.error + "\"").c_str() );
+         ++failures;
+      }
+   }
+
+#define EXPECT( cond ) expect( (cond), #cond, __LINE__ )
+#define EXPECT_OK( r ) expect_ok( (r), __LINE__ )
+#define EXPECT_ERROR( r, error ) expect_error( (r), (error), __LINE__ )
+
+   // Accounts "taa", "tab", ... to receive shares (digits above 5 can't be in a name).
+   name target( int i ) {
+      const char str[] = { 't', char('a' + i / 26 % 26), char('a' + i % 26) };
+      return name( std::string_view( str, sizeof(str) ) );
+   }
+
+   asset xdl( int64_t amount ) { return asset( amount, XDL ); }
+
+   token::balance_view view( name owner, symbol_code sym = XDL.code() ) {
+      return token::get_balance_view( contract_account, owner, sym );
+   }
+
+   // The balance in the owner's row, before the tax it owes today.
+   int64_t stored( name owner, symbol_code sym = XDL.code() ) {
+      const auto v = view( owner, sym );
+      return v.balance.amount + v.pending_tax.amount;
+   }
+
+   // What the owner would have after being settled and claiming today, before income shares.
+   int64_t settled( name owner ) {
+      const auto v = view( owner );
+      return v.balance.amount + v.claimable.amount;
+   }
+
+   size_t count( const action_result& r, name type, name owner = name() ) {
+      size_t n = 0;
+      for( const auto& e : r.events )
+         n += (e.type == type) && (!owner || e.owner == owner);
+      return n;
+   }
+
+   size_t count_sent( const action_result& r, name act ) {
+      return std::count( r.sent.begin(), r.sent.end(), act );
+   }
+
+   // The table and primary key that hold an owner's XDL balance in this build.
+   bool has_balance_row( harness& h, name owner ) {
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      return h.has_row( "holdings"_n, owner.value, 0 );
+#else
+      return h.has_row( "accounts"_n, owner.value, XDL.code().raw() );
+#endif
+   }
+
+   name balance_payer( harness& h, name owner ) {
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      return h.payer( "holdings"_n, owner.value, 0 );
+#else
+      return h.payer( "accounts"_n, owner.value, XDL.code().raw() );
+#endif
+   }
+
+   bool is_holder( harness& h, name owner ) {
+      return h.has_row( "holders"_n, contract_account.value, owner.value );
+   }
+
+   // A token whose issuer has given alice and bob 1000000 XDL each, on day 19000.
+   harness setup( std::initializer_list<name> others = {} ) {
+      harness h( { issuer, alice, bob, carol, dave, erin, faucet } );
+      for( auto a : others )
+         h.add_account( a );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.create( issuer, xdl( 1000000000000000ll ) ); } ) );
+      EXPECT_OK( h.run( { issuer }, [&]( token& c ) { c.issue( issuer, xdl( 100000000000ll ), "" ); } ) );
+      EXPECT_OK( h.run( { issuer }, [&]( token& c ) { c.transfer( issuer, alice, xdl( 10000000000ll ), "" ); } ) );
+      EXPECT_OK( h.run( { issuer }, [&]( token& c ) { c.transfer( issuer, bob, xdl( 10000000000ll ), "" ); } ) );
+      return h;
+   }
+
+   void test_transfer() {
+      harness h = setup();
+      h.advance_days( 1 );
+      const int64_t a = settled( alice ), b = settled( bob );
+      auto r = h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, xdl( 12345 ), "" ); } );
+      EXPECT_OK( r );
+      EXPECT( stored( alice ) == a - 12345 );
+      EXPECT( stored( bob ) == b + 12345 );
+      EXPECT( count( r, "tax"_n ) == 2 );
+      EXPECT( count( r, "income"_n, alice ) == 1 && count( r, "income"_n, bob ) == 1 );
+
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.transfer( alice, alice, xdl( 1 ), "" ); } ), "cannot transfer to self" );
+      EXPECT_ERROR( h.run( { bob }, [&]( token& c ) { c.transfer( alice, bob, xdl( 1 ), "" ); } ), "missing authority of alice" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.transfer( alice, "nobody"_n, xdl( 1 ), "" ); } ), "to account does not exist" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, xdl( a ), "" ); } ), "overdrawn balance" );
+      EXPECT( stored( alice ) == a - 12345 );
+   }
+
+   void test_transferclose() {
+      harness h = setup();
+      h.advance_days( 1 );
+
+      const auto va = view( alice );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.transferclose( alice, bob, va.balance + xdl( 1 ), "" ); } ),
+                    "quantity must be the whole balance after demurrage" );
+
+      // Only the tax of "from" is settled: its pending income is given up with the row.
+      const int64_t b = settled( bob );
+      auto r = h.run( { alice }, [&]( token& c ) { c.transferclose( alice, bob, va.balance, "" ); } );
+      EXPECT_OK( r );
+      EXPECT( h.balance( alice ) == -1 );
+      EXPECT( !is_holder( h, alice ) );
+      EXPECT( stored( bob ) == b + va.balance.amount );
+      EXPECT( count( r, "income"_n, alice ) == 0 && count( r, "tax"_n, alice ) == 1 );
+
+      // Not on a day the income was claimed, like close().
+      h.advance_days( 1 );
+      EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.claim( bob ); } ) );
+      EXPECT_ERROR( h.run( { bob }, [&]( token& c ) { c.transferclose( bob, alice, view( bob ).balance, "" ); } ),
+                    "Cannot close() yet: income was already claimed for today." );
+   }
+
+   void test_transferclose_shared_back() {
+      harness h = setup();
+      EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.setshare( bob, alice, 50 ); } ) );
+      h.advance_days( 1 );
+
+      // Settling bob shares part of his income with alice, whose balance is then not the one
+      //   she asked to send, so nothing is closed.
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.transferclose( alice, bob, view( alice ).balance, "" ); } ),
+                    "quantity must be the whole balance after demurrage" );
+      EXPECT( has_balance_row( h, alice ) && is_holder( h, alice ) );
+   }
+
+   void test_transfermany() {
+      harness h = setup();
+      h.advance_days( 1 );
+      const int64_t a = settled( alice ), b = settled( bob );
+
+      // Carol has no balance row yet, and gets one paid for by alice.
+      std::vector<token::payment> payments = { { bob, xdl( 5 ) }, { carol, xdl( 7 ) }, { bob, xdl( 3 ) } };
+      auto r = h.run( { alice }, [&]( token& c ) { c.transfermany( alice, payments, "" ); } );
+      EXPECT_OK( r );
+      EXPECT( stored( alice ) == a - 15 );
+      EXPECT( stored( bob ) == b + 8 );
+      EXPECT( stored( carol ) == 7 );
+      EXPECT( balance_payer( h, carol ) == alice );
+      EXPECT( count( r, "income"_n, bob ) == 1 && count( r, "tax"_n, bob ) == 1 );
+      EXPECT( count( r, "income"_n, alice ) == 1 );
+
+      auto rejected = [&]( std::vector<token::payment> p, const char* error ) {
+         EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.transfermany( alice, p, "" ); } ), error );
+      };
+      rejected( {}, "no payments" );
+      rejected( { { bob, xdl( 1 ) }, { alice, xdl( 1 ) } }, "cannot transfer to self" );
+      rejected( { { bob, xdl( 1 ) }, { "nobody"_n, xdl( 1 ) } }, "to account does not exist" );
+      rejected( { { bob, xdl( 1 ) }, { carol, xdl( 0 ) } }, "must transfer positive quantity" );
+      rejected( { { bob, xdl( 1 ) }, { carol, asset( 1, symbol( "XDL", 2 ) ) } }, "symbol precision mismatch" );
+      rejected( { { bob, xdl( a ) }, { carol, xdl( 1 ) } }, "overdrawn balance" );
+      EXPECT( stored( alice ) == a - 15 && stored( carol ) == 7 );
+   }
+
+   void test_claim() {
+      harness h = setup();
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ) );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ), "no pending income to claim" );
+
+      // A day of income for each day since the last claim, up to max_past_claim_days.
+      h.advance_days( 3 );
+      const int64_t a = stored( alice );
+      auto r = h.run( { alice }, [&]( token& c ) { c.claim( alice ); } );
+      EXPECT_OK( r );
+      EXPECT( r.events.size() == 2 && count( r, "income"_n, alice ) == 1 && r.events[1].amount == 30000 );
+      EXPECT( stored( alice ) == a - r.events[0].amount + 30000 );
+
+      h.advance_days( 1000 );
+      r = h.run( { alice }, [&]( token& c ) { c.claim( alice ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "income"_n, alice ) == 1 && r.events.back().amount == 3610000 );
+   }
+
+   void test_claimfor() {
+      harness h = setup();
+      h.advance_days( 1 );
+
+      // A new account gets its balance row from the ram_payer, with the claim.
+      auto r = h.run( { faucet }, [&]( token& c ) { c.claimfor( dave, faucet ); } );
+      EXPECT_OK( r );
+      EXPECT( stored( dave ) == 10000 );
+      EXPECT( balance_payer( h, dave ) == faucet && is_holder( h, dave ) );
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.claimfor( "nobody"_n, faucet ); } ), "owner account does not exist" );
+      EXPECT_ERROR( h.run( { dave }, [&]( token& c ) { c.claimfor( alice, faucet ); } ), "missing authority of faucet" );
+   }
+
+   void test_claimmany() {
+      harness h = setup();
+      h.advance_days( 1 );
+      const int64_t a = settled( alice ), b = settled( bob );
+
+      // An owner listed twice claims once, and owners without a row get one from the ram_payer.
+      std::vector<name> owners = { alice, bob, alice, dave };
+      auto r = h.run( { faucet }, [&]( token& c ) { c.claimmany( owners, faucet ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "income"_n ) == 3 && count( r, "income"_n, alice ) == 1 );
+      EXPECT( stored( alice ) == a && stored( bob ) == b && stored( dave ) == 10000 );
+      EXPECT( balance_payer( h, dave ) == faucet );
+
+      // Owners with nothing to claim are skipped.
+      r = h.run( { faucet }, [&]( token& c ) { c.claimmany( owners, faucet ); } );
+      EXPECT_OK( r );
+      EXPECT( r.events.empty() );
+
+      owners.push_back( "nobody"_n );
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.claimmany( owners, faucet ); } ), "owner account does not exist" );
+   }
+
+   // Income shared on by share recipients is capped per owner, not for the whole list.
+   void test_claimmany_share_budget() {
+      const int n = max_share_payouts + 1;
+      harness h = setup();
+      EXPECT_OK( h.run( { issuer }, [&]( token& c ) { c.transfer( issuer, carol, xdl( 10000000000ll ), "" ); } ) );
+      EXPECT_OK( h.run( { issuer }, [&]( token& c ) { c.transfer( issuer, dave, xdl( 10000000000ll ), "" ); } ) );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setshare( alice, carol, 100 ); } ) );
+      EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.setshare( bob, dave, 100 ); } ) );
+      for( int i = 1; i <= n; ++i ) {
+         h.add_account( target( i ) );
+         h.add_account( target( 100 + i ) );
+         EXPECT_OK( h.run( { carol }, [&]( token& c ) { c.setshare( carol, target( i ), 1 ); } ) );
+         EXPECT_OK( h.run( { dave }, [&]( token& c ) { c.setshare( dave, target( 100 + i ), 1 ); } ) );
+      }
+
+      h.advance_days( 1 );
+      const std::vector<name> owners = { alice, bob };
+      auto r = h.run( { faucet }, [&]( token& c ) { c.claimmany( owners, faucet ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "shareincome"_n, carol ) == max_share_payouts );
+      EXPECT( count( r, "shareincome"_n, dave ) == max_share_payouts );
+   }
+
+   void test_open_close() {
+      harness h = setup();
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.open( dave, XDL, faucet ); } ) );
+      EXPECT( stored( dave ) == 0 && balance_payer( h, dave ) == faucet && is_holder( h, dave ) );
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.open( dave, XDL, faucet ); } ) );
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.open( "nobody"_n, XDL, faucet ); } ), "owner account does not exist" );
+
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.close( alice, XDL ); } ), "Cannot close because the balance is not zero." );
+      EXPECT_OK( h.run( { dave }, [&]( token& c ) { c.close( dave, XDL ); } ) );
+      EXPECT( h.balance( dave ) == -1 && !is_holder( h, dave ) );
+      EXPECT_ERROR( h.run( { dave }, [&]( token& c ) { c.close( dave, XDL ); } ),
+                    "Balance row already deleted or never existed. Action won't have any effect." );
+   }
+
+   void test_shares() {
+      harness h = setup();
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setshare( alice, bob, 30 ); } ) );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setshare( alice, carol, 20 ); } ) );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setshare( alice, dave, 51 ); } ), "share total would exceed 100%" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setshare( alice, alice, 1 ); } ), "cannot setshare to self" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setshare( alice, "nobody"_n, 1 ); } ), "to account does not exist" );
+
+      h.advance_days( 2 );
+      const int64_t a = settled( alice ), b = settled( bob ), income = view( alice ).claimable.amount;
+      auto r = h.run( { alice }, [&]( token& c ) { c.claim( alice ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "shareincome"_n, alice ) == 2 );
+      EXPECT( stored( alice ) == a - income / 2 );
+      EXPECT( stored( bob ) == b + income * 3 / 10 );
+      EXPECT( stored( carol ) == income / 5 );
+
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.resetshare( alice ); } ) );
+      EXPECT( h.rows( "shares"_n, alice.value ) == 0 && h.rows( "sharetotals"_n, alice.value ) == 0 );
+   }
+
+   // Income shared on by share recipients counts against max_share_payouts; the direct shares of
+   //   the claimant don't.
+   void test_share_cascade() {
+      const int n = max_share_payouts + 2;
+      std::vector<name> targets;
+      for( int i = 1; i <= n; ++i )
+         targets.push_back( target( i ) );
+      harness h = setup();
+      for( auto t : targets )
+         h.add_account( t );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setshare( alice, bob, 100 ); } ) );
+      for( auto t : targets )
+         EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.setshare( bob, t, 1 ); } ) );
+
+      h.advance_days( 1 );
+      auto r = h.run( { alice }, [&]( token& c ) { c.claim( alice ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "shareincome"_n, alice ) == 1 );
+      EXPECT( count( r, "shareincome"_n, bob ) == max_share_payouts );
+      int paid = 0;
+      for( auto t : targets )
+         paid += (h.balance( t ) > 0);
+      EXPECT( paid == int(max_share_payouts) );
+   }
+
+   void test_setlazy() {
+      harness h = setup();
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setlazy( alice, false ); } ), "account is not in lazy settlement mode" );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setlazy( alice, true ); } ) );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setlazy( alice, true ); } ), "account is already in lazy settlement mode" );
+      EXPECT_ERROR( h.run( { dave }, [&]( token& c ) { c.setlazy( dave, true ); } ), "no balance object found" );
+
+      // Receiving only charges the tax: the income waits for alice's next claim or debit.
+      h.advance_days( 3 );
+      const int64_t a = view( alice ).balance.amount;
+      auto r = h.run( { bob }, [&]( token& c ) { c.transfer( bob, alice, xdl( 1 ), "" ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "tax"_n, alice ) == 1 && count( r, "income"_n, alice ) == 0 );
+      EXPECT( view( alice ).pending_tax.amount == 0 && view( alice ).claimable.amount == 30000 );
+      EXPECT( stored( alice ) == a + 1 );
+
+      r = h.run( { alice }, [&]( token& c ) { c.claim( alice ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "tax"_n, alice ) == 0 && count( r, "income"_n, alice ) == 1 );
+      EXPECT( stored( alice ) == a + 1 + 30000 );
+
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setlazy( alice, false ); } ) );
+   }
+
+   void test_settle() {
+      harness h = setup();
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ) );
+      EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.claim( bob ); } ) );
+      EXPECT_ERROR( h.run( {}, [&]( token& c ) { c.settle( 10 ); } ), "no accounts to settle" );
+      EXPECT_ERROR( h.run( {}, [&]( token& c ) { c.settle( 0 ); } ), "max_accounts must be positive" );
+
+      // Only the tax is charged, to the accounts that have gone the longest without it, and the
+      //   rows keep their payer.
+      h.advance_days( 10 );
+      const name alice_payer = balance_payer( h, alice );
+      const auto va = view( alice ), vb = view( bob ), vi = view( issuer );
+      auto r = h.run( {}, [&]( token& c ) { c.settle( 2 ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "tax"_n ) == 2 && count( r, "income"_n ) == 0 );
+      r = h.run( {}, [&]( token& c ) { c.settle( 10 ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "tax"_n ) == 1 );
+      EXPECT_ERROR( h.run( {}, [&]( token& c ) { c.settle( 10 ); } ), "no accounts to settle" );
+      EXPECT( stored( alice ) == va.balance.amount && stored( bob ) == vb.balance.amount && stored( issuer ) == vi.balance.amount );
+      EXPECT( balance_payer( h, alice ) == alice_payer );
+
+      // The income is still all there, and the tax isn't charged again.
+      r = h.run( { alice }, [&]( token& c ) { c.claim( alice ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "tax"_n ) == 0 && count( r, "income"_n, alice ) == 1 && r.events[0].amount == 100000 );
+   }
+
+   void test_accrual() {
+      harness h = setup();
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setshare( alice, bob, 50 ); } ) );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setshare( alice, carol, 25 ); } ) );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setaccrual( alice, true ); } ) );
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.payshares( alice, faucet ); } ), "no share income to pay" );
+
+      // The shared part of the income waits in the pool, and the shares can't change meanwhile.
+      h.advance_days( 1 );
+      const int64_t a = settled( alice );
+      auto r = h.run( { alice }, [&]( token& c ) { c.claim( alice ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "shareincome"_n ) == 0 );
+      EXPECT( stored( alice ) == a - 7500 );
+      EXPECT( h.has_row( "sharepools"_n, alice.value, 0 ) );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setshare( alice, bob, 10 ); } ), "share pool must be paid first (see payshares)" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.resetshare( alice ); } ), "share pool must be paid first (see payshares)" );
+
+      const int64_t b = settled( bob );
+      r = h.run( { faucet }, [&]( token& c ) { c.payshares( alice, faucet ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "shareincome"_n, alice ) == 2 );
+      EXPECT( stored( bob ) == b + 5000 && stored( carol ) == 2500 );
+      EXPECT( balance_payer( h, carol ) == faucet );
+      EXPECT( !h.has_row( "sharepools"_n, alice.value, 0 ) );
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.payshares( alice, faucet ); } ), "no share income to pay" );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setaccrual( alice, false ); } ) );
+      EXPECT( h.rows( "settings"_n, alice.value ) == 0 );
+   }
+
+   // A pool with more shares than max_share_payouts is paid over several payshares calls, each
+   //   carrying on from the share where the last one stopped.
+   void test_payshares_resume() {
+      const int n = std::min( 100, int(2 * max_share_payouts + 1) );
+      std::vector<name> targets;
+      for( int i = 1; i <= n; ++i )
+         targets.push_back( target( i ) );
+      harness h = setup();
+      for( auto t : targets )
+         h.add_account( t );
+      for( auto t : targets )
+         EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setshare( alice, t, 1 ); } ) );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setaccrual( alice, true ); } ) );
+      h.advance_days( 1 );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ) );
+
+      auto r = h.run( { faucet }, [&]( token& c ) { c.payshares( alice, faucet ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "shareincome"_n ) == max_share_payouts );
+      EXPECT( h.has_row( "sharepools"_n, alice.value, 0 ) );
+      std::map<uint64_t, int> received;
+      for( const auto& e : r.events )
+         received[e.to.value] += (e.type == "shareincome"_n) && (e.amount == 100);
+
+      // Income that arrives while a payout is in progress is paid once it is done.
+      h.advance_days( 1 );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ) );
+      int calls = 1;
+      for( ; calls < 10; ++calls ) {
+         r = h.run( { faucet }, [&]( token& c ) { c.payshares( alice, faucet ); } );
+         if( !r.ok )
+            break;
+         EXPECT( count( r, "shareincome"_n ) <= max_share_payouts );
+         for( const auto& e : r.events )
+            received[e.to.value] += (e.type == "shareincome"_n) && (e.amount == 100);
+      }
+      EXPECT_ERROR( r, "no share income to pay" );
+      EXPECT( calls == 2 * ((n + int(max_share_payouts) - 1) / int(max_share_payouts)) );
+      EXPECT( !h.has_row( "sharepools"_n, alice.value, 0 ) );
+      int twice = 0;
+      for( auto t : targets )
+         twice += (received[t.value] == 2);
+      EXPECT( twice == n );
+   }
+
+   void test_setquota() {
+      harness h = setup( { target( 1 ), target( 2 ) } );
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.setquota( faucet, 0 ); } ), "no quota to remove" );
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.setquota( faucet, 2 ); } ) );
+
+      // A new account counts once, for its balance row and its holders row.
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.claimfor( dave, faucet ); } ) );
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.open( erin, XDL, faucet ); } ) );
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.claimfor( carol, faucet ); } ), "ram_payer has reached its daily quota of new accounts" );
+      const std::vector<name> owners = { carol };
+      EXPECT_ERROR( h.run( { faucet }, [&]( token& c ) { c.claimmany( owners, faucet ); } ), "ram_payer has reached its daily quota of new accounts" );
+
+      // The payer's own rows, and rows that already exist, don't count.
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.claimfor( faucet, faucet ); } ) );
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.open( dave, XDL, faucet ); } ) );
+
+      h.advance_days( 1 );
+      const std::vector<name> more = { carol, target( 1 ) };
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.claimmany( more, faucet ); } ) );
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.setquota( faucet, 0 ); } ) );
+      EXPECT_OK( h.run( { faucet }, [&]( token& c ) { c.claimfor( target( 2 ), faucet ); } ) );
+   }
+
+   void test_addholders() {
+      harness h = setup();
+      EXPECT( is_holder( h, alice ) && is_holder( h, bob ) && is_holder( h, issuer ) );
+
+      // Owners that are already holders, or have no balance, are skipped.
+      std::vector<name> owners = { alice, dave };
+      auto r = h.run( { faucet }, [&]( token& c ) { c.addholders( owners, faucet ); } );
+      EXPECT_OK( r );
+      EXPECT( r.rows_billed == 0 && !is_holder( h, dave ) );
+      EXPECT( h.payer( "holders"_n, contract_account.value, alice.value ) != faucet );
+   }
+
+   void test_rollup() {
+      harness h = setup();
+      h.advance_days( 1 );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ) );
+#ifdef DAILYCOIN_SHARDED_STATS
+      const int64_t supply = h.supply();
+      EXPECT( h.rows( "statshards"_n, XDL.code().raw() ) > 0 );
+      EXPECT_OK( h.run( {}, [&]( token& c ) { c.rollup( XDL.code() ); } ) );
+      EXPECT( h.supply() == supply );
+      EXPECT_ERROR( h.run( {}, [&]( token& c ) { c.rollup( XDL.code() ); } ), "nothing to roll up" );
+#else
+      EXPECT_ERROR( h.run( {}, [&]( token& c ) { c.rollup( XDL.code() ); } ), "sharded stats are not enabled" );
+#endif
+   }
+
+   void test_day_stats() {
+      harness h = setup();
+      h.advance_days( 1 );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ) );
+#ifdef DAILYCOIN_DAY_STATS
+      EXPECT( h.has_row( "daystats"_n, XDL.code().raw(), 19001 ) );
+      h.advance_days( 200 );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ) );
+      EXPECT( h.rows( "daystats"_n, XDL.code().raw() ) == 1 );
+#else
+      EXPECT( h.rows( "daystats"_n, XDL.code().raw() ) == 0 );
+#endif
+   }
+
+   void test_migrate() {
+      harness h = setup();
+      const std::vector<name> owners = { alice, dave };
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.migrate( owners ); } ), "missing authority of dailycoin" );
+#ifdef DAILYCOIN_COMPACT_ACCOUNTS
+      // New balances are already compact, so there is nothing to move.
+      EXPECT( h.has_row( "holdings"_n, alice.value, 0 ) && h.rows( "accounts"_n, alice.value ) == 0 );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.migrate( owners ); } ) );
+      EXPECT( h.has_row( "migrations"_n, contract_account.value, 0 ) );
+      EXPECT( h.has_row( "holdings"_n, alice.value, 0 ) );
+#else
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.migrate( owners ); } ), "compact accounts are not enabled" );
+#endif
+   }
+
+   void test_restore() {
+      harness h( { issuer, alice, bob, carol } );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.create( issuer, xdl( 1000000000000000ll ) ); } ) );
+      const std::vector<token::snapshot_account> accounts = { { alice, 500000, 18990, 0, false }, { bob, 7, 18000, 18995, true } };
+      const std::vector<token::snapshot_share> shares = { { alice, bob, 40 }, { alice, carol, 60 } };
+      const std::vector<token::snapshot_pool> pools = { { alice, 1000, 0, 0, 0, name() } };
+      const std::vector<token::snapshot_profile> profiles = { { carol, "hello" } };
+      const std::vector<token::snapshot_setting> settings = { { carol, 1, 0 } };
+#ifdef DAILYCOIN_RESTORE
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.loadaccounts( XDL, accounts ); } ), "missing authority of dailycoin" );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.loadaccounts( XDL, accounts ); } ) );
+      EXPECT( stored( alice ) == 500000 && stored( bob ) == 7 && h.supply() == 500007 );
+      EXPECT( view( alice ).pending_tax.amount > 0 && view( bob ).claimable.amount == 3610000 );
+      EXPECT( balance_payer( h, alice ) == contract_account && is_holder( h, bob ) );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadaccounts( XDL, { { alice, 1, 0, 0, false } } ); } ), "account already exists" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadaccounts( XDL, { { "nobody"_n, 1, 0, 0, false } } ); } ), "owner account does not exist" );
+
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadpools( pools ); } ), "no shares to pay" );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.loadshares( shares ); } ) );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadshares( { { alice, bob, 1 } } ); } ), "share already exists" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadshares( { { bob, "nobody"_n, 1 } } ); } ), "to account does not exist" );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.loadpools( pools ); } ) );
+      EXPECT( h.supply() == 501007 );
+      const int64_t b = view( bob ).balance.amount;
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.payshares( alice, alice ); } ) );
+      EXPECT( view( bob ).balance.amount == b + 400 && stored( carol ) == 600 );
+
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.loadprofiles( profiles ); } ) );
+      EXPECT( h.has_row( "profiles"_n, carol.value, 0 ) );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadprofiles( { { bob, "" } } ); } ), "profile is empty" );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.loadsettings( settings ); } ) );
+      EXPECT( h.has_row( "settings"_n, carol.value, 0 ) );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadsettings( { { bob, 0x100, 0 } } ); } ), "invalid flags" );
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.loadstat( XDL.code(), xdl( 5 ), 3 ); } ) );
+#else
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadaccounts( XDL, accounts ); } ), "restore is not enabled" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadshares( shares ); } ), "restore is not enabled" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadpools( pools ); } ), "restore is not enabled" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadprofiles( profiles ); } ), "restore is not enabled" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadsettings( settings ); } ), "restore is not enabled" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.loadstat( XDL.code(), xdl( 5 ), 3 ); } ), "restore is not enabled" );
+#endif
+   }
+
+   void test_events() {
+      harness h = setup();
+      h.advance_days( 1 );
+      auto r = h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, xdl( 1 ), "" ); } );
+      EXPECT_OK( r );
+      EXPECT( r.events.size() == 4 && count( r, "tax"_n ) == 2 && count( r, "income"_n ) == 2 );
+#if defined(DAILYCOIN_PACKED_EVENTS)
+      EXPECT( r.sent.size() == 1 && count_sent( r, "evpack"_n ) == 1 );
+#elif defined(DAILYCOIN_BATCH_EVENTS)
+      EXPECT( r.sent.size() == 1 && count_sent( r, "events"_n ) == 1 );
+#else
+      EXPECT( count_sent( r, "tax"_n ) == 2 && count_sent( r, "income"_n ) == 2 );
+#endif
+
+      // Notifications can only come from the contract.
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.events( {} ); } ), "missing authority of dailycoin" );
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.evpack( { 9 } ); } ), "invalid event pack" );
+
+      // Muted events are not sent.
+      EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.setnotify( bob, false, true, true, xdl( 0 ) ); } ) );
+      h.advance_days( 1 );
+      r = h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, xdl( 1 ), "" ); } );
+      EXPECT_OK( r );
+      EXPECT( count( r, "tax"_n, bob ) == 0 && count( r, "tax"_n, alice ) == 1 && count( r, "income"_n, bob ) == 1 );
+   }
+
+   void test_profiles() {
+      harness h = setup();
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setprofile( alice, "hello world" ); } ) );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setprofpart( alice, 6, "there" ); } ) );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setprofpart( alice, 12, "x" ); } ), "offset is past the end of the profile" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setprofpart( alice, 0, std::string( 1025, 'x' ) ); } ), "profile has more than 1024 bytes" );
+
+      // A hashed profile takes the place of the stored one, and the other way round.
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setprofhash( alice, "hello there" ); } ) );
+      EXPECT( !h.has_row( "profiles"_n, alice.value, 0 ) && h.has_row( "profhashes"_n, alice.value, 0 ) );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setprofhash( alice, std::string( 1025, 'x' ) ); } ), "profile has more than 1024 bytes" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.setprofpart( alice, 0, "x" ); } ), "no profile to update" );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setprofile( alice, "again" ); } ) );
+      EXPECT( h.has_row( "profiles"_n, alice.value, 0 ) && !h.has_row( "profhashes"_n, alice.value, 0 ) );
+      EXPECT_OK( h.run( { alice }, [&]( token& c ) { c.setprofile( alice, "" ); } ) );
+      EXPECT( h.rows( "profiles"_n, alice.value ) == 0 );
+   }
+
+   void test_multi_token() {
+      harness h = setup();
+      const symbol abc( "ABC", 4 );
+#ifdef DAILYCOIN_MULTI_TOKEN
+      const int64_t xdl_balance = stored( alice ), xdl_supply = h.supply();
+      EXPECT_OK( h.run( { contract_account }, [&]( token& c ) { c.create( issuer, asset( 1000000000, abc ) ); } ) );
+      EXPECT_OK( h.run( { issuer }, [&]( token& c ) { c.issue( issuer, asset( 5000, abc ), "" ); } ) );
+      EXPECT_OK( h.run( { issuer }, [&]( token& c ) { c.transfer( issuer, alice, asset( 3000, abc ), "" ); } ) );
+      EXPECT( stored( alice, abc.code() ) == 3000 && h.supply( abc.code() ) >= 5000 );
+      EXPECT( stored( alice ) == xdl_balance && h.supply() == xdl_supply );
+      EXPECT_ERROR( h.run( { issuer }, [&]( token& c ) { c.issue( issuer, asset( 1, symbol( "ABC", 2 ) ), "" ); } ), "symbol precision mismatch" );
+
+      // Closing another token's row leaves the XDL holders row alone.
+      EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.open( bob, abc, bob ); } ) );
+      EXPECT_OK( h.run( { bob }, [&]( token& c ) { c.close( bob, abc ); } ) );
+      EXPECT( h.balance( bob, abc.code() ) == -1 && has_balance_row( h, bob ) && is_holder( h, bob ) );
+#else
+      EXPECT_ERROR( h.run( { contract_account }, [&]( token& c ) { c.create( issuer, asset( 1000000000, abc ) ); } ), "unsupported symbol" );
+      EXPECT_ERROR( h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, asset( 1, abc ), "" ); } ), "unsupported symbol" );
+#endif
+   }
+
+   struct test_case {
+      const char*  name;
+      void         (*run)();
+   };
+
+   const test_case tests[] = {
+      { "transfer", test_transfer },
+      { "transferclose", test_transferclose },
+      { "transferclose, shared back", test_transferclose_shared_back },
+      { "transfermany", test_transfermany },
+      { "claim", test_claim },
+      { "claimfor", test_claimfor },
+      { "claimmany", test_claimmany },
+      { "claimmany share budget", test_claimmany_share_budget },
+      { "open and close", test_open_close },
+      { "shares", test_shares },
+      { "share cascade", test_share_cascade },
+      { "setlazy", test_setlazy },
+      { "settle", test_settle },
+      { "setaccrual and payshares", test_accrual },
+      { "payshares resume", test_payshares_resume },
+      { "setquota", test_setquota },
+      { "addholders", test_addholders },
+      { "rollup", test_rollup },
+      { "day stats", test_day_stats },
+      { "migrate", test_migrate },
+      { "restore", test_restore },
+      { "events", test_events },
+      { "profiles", test_profiles },
+      { "multi token", test_multi_token },
+   };
+
+} // namespace
+
+int main()
+{
+   int failed = 0;
+   for( const auto& t : tests ) {
+      const int before = failures;
+      t.run();
+      std::printf( "%-30s %s\n", t.name, (failures == before) ? "ok" : "FAILED" );
+      failed += (failures != before);
+   }
+   return failed ? 1 : 0;
+}
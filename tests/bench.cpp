@@ -0,0 +1,136 @@
+/**
+ *  Database calls, inline actions and time per action on the transfer, claim and share paths.
+ *  Every case runs its action a number of times and prints the averages; any failed action
+ *  fails the benchmark.
+ */
+#include "harness.hpp"
+
+#include <cstdio>
+
+using namespace dailycoin_test;
+
+namespace {
+
+   const name issuer = "issuer"_n;
+   const name alice  = "alice"_n;
+   const name bob    = "bob"_n;
+   const name faucet = "faucet"_n;
+
+   // Accounts "taa", "tab", ... to receive shares (digits above 5 can't be in a name).
+   name target( int i ) {
+      const char str[] = { 't', char('a' + i / 26 % 26), char('a' + i % 26) };
+      return name( std::string_view( str, sizeof(str) ) );
+   }
+
+   struct totals {
+      int                  actions = 0;
+      native::db_counters  db;
+      uint64_t             sent = 0;
+      uint64_t             billed = 0;
+      double               micros = 0;
+   };
+
+   bool failed = false;
+
+   void add( totals& t, const action_result& r, const char* label ) {
+      if( !r.ok ) {
+         std::fprintf( stderr, "%s: %s\n", label, r.error.c_str() );
+         failed = true;
+      }
+      ++t.actions;
+      t.db.finds    += r.db.finds;
+      t.db.modifies += r.db.modifies;
+      t.db.emplaces += r.db.emplaces;
+      t.db.erases   += r.db.erases;
+      t.db.nexts    += r.db.nexts;
+      t.sent        += r.sent.size();
+      t.billed      += r.rows_billed;
+      t.micros      += r.micros;
+   }
+
+   void report( const char* label, const totals& t ) {
+      const double n = t.actions;
+      std::printf( "%-34s %6d %7.1f %7.1f %7.1f %7.1f %7.1f %6.1f %6.1f %9.2f\n", label, t.actions,
+                   t.db.finds / n, t.db.modifies / n, t.db.emplaces / n, t.db.erases / n, t.db.nexts / n,
+                   t.sent / n, t.billed / n, t.micros / n );
+   }
+
+   // A token with alice and bob holding some of it, and "shares" target accounts.
+   harness setup( int shares = 0 ) {
+      harness h( { issuer, alice, bob, faucet } );
+      for( int i = 1; i <= shares; ++i )
+         h.add_account( target( i ) );
+      h.run( { contract_account }, [&]( token& c ) { c.create( issuer, asset( 1000000000000000ll, XDL ) ); } );
+      h.run( { issuer }, [&]( token& c ) { c.issue( issuer, asset( 100000000000ll, XDL ), "" ); } );
+      h.run( { issuer }, [&]( token& c ) { c.transfer( issuer, alice, asset( 10000000000ll, XDL ), "" ); } );
+      h.run( { issuer }, [&]( token& c ) { c.transfer( issuer, bob, asset( 10000000000ll, XDL ), "" ); } );
+      return h;
+   }
+
+   void bench_transfer( int runs ) {
+      totals same_day, next_day;
+      harness h = setup();
+      for( int i = 0; i < runs; ++i )
+         add( same_day, h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, asset( 1, XDL ), "" ); } ), "transfer" );
+      for( int i = 0; i < runs; ++i ) {
+         h.advance_days( 1 );
+         add( next_day, h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, asset( 1, XDL ), "" ); } ), "transfer" );
+      }
+      report( "transfer, same day", same_day );
+      report( "transfer, both claim and pay tax", next_day );
+   }
+
+   void bench_claimfor( int shares, int runs ) {
+      totals t;
+      harness h = setup( shares );
+      for( int i = 1; i <= shares; ++i ) {
+         h.run( { alice }, [&]( token& c ) { c.setshare( alice, target( i ), 100 / shares ); } );
+         h.run( { target( i ) }, [&]( token& c ) { c.open( target( i ), XDL, target( i ) ); } );
+      }
+      for( int i = 0; i < runs; ++i ) {
+         h.advance_days( 1 );
+         add( t, h.run( { faucet }, [&]( token& c ) { c.claimfor( alice, faucet ); } ), "claimfor" );
+      }
+      report( ("claimfor, " + std::to_string( shares ) + " shares").c_str(), t );
+   }
+
+   void bench_setshare( int targets ) {
+      totals add_share, update_share;
+      harness h = setup( targets );
+      for( int i = 1; i <= targets; ++i )
+         add( add_share, h.run( { alice }, [&]( token& c ) { c.setshare( alice, target( i ), 1 ); } ), "setshare" );
+      for( int i = 1; i <= targets; ++i )
+         add( update_share, h.run( { alice }, [&]( token& c ) { c.setshare( alice, target( i ), 1 ); } ), "setshare" );
+      report( ("setshare, new, up to " + std::to_string( targets ) + " targets").c_str(), add_share );
+      report( ("setshare, update, " + std::to_string( targets ) + " targets").c_str(), update_share );
+   }
+
+   void bench_dormant( int days, int runs ) {
+      totals claim, transfer;
+      for( int i = 0; i < runs; ++i ) {
+         harness h = setup();
+         h.advance_days( days );
+         add( claim, h.run( { alice }, [&]( token& c ) { c.claim( alice ); } ), "claim" );
+         h.advance_days( days );
+         add( transfer, h.run( { alice }, [&]( token& c ) { c.transfer( alice, bob, asset( 1, XDL ), "" ); } ), "transfer" );
+      }
+      report( ("claim after " + std::to_string( days ) + " idle days").c_str(), claim );
+      report( ("transfer after " + std::to_string( days ) + " idle days").c_str(), transfer );
+   }
+
+} // namespace
+
+int main()
+{
+   std::printf( "%-34s %6s %7s %7s %7s %7s %7s %6s %6s %9s\n", "per action", "runs",
+                "find", "modify", "emplace", "erase", "next", "sends", "rows", "us" );
+   bench_transfer( 200 );
+   bench_claimfor( 0, 200 );
+   bench_claimfor( 1, 200 );
+   bench_claimfor( 10, 200 );
+   bench_claimfor( 100, 50 );
+   bench_setshare( 100 );
+   bench_dormant( 30, 50 );
+   bench_dormant( 3650, 50 );
+   return failed ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/**
+ *  Replays the same random history against the baseline contract and against this one, and
+ *  checks that they agree step by step.
+ *
+ *  The two are not expected to be identical. The fixed-point demurrage tax can differ by one
+ *  unit from the pow() version it replaced, and that difference is carried by the balance from
+ *  then on, so a balance may be off by at most one unit for each step that changed it, and the
+ *  supply by the sum of those. Events may come in another order, since shares are now paid
+ *  breadth first, so they are compared as sets; and a tax that rounds to zero in one build
+ *  but not in the other can add or drop a "tax" event where balances already differ. The
+ *  baseline also pays an untaxed account (too small to owe a unit of tax) a day of income on
+ *  every claim; replay.cpp keeps every account big enough that this never happens.
+ *
+ *  In "accrual" mode shares are paid by payshares, and the events they send don't match the
+ *  baseline's, so only outcomes, balances and the supply are compared. In "lazy" mode income
+ *  is only claimed for certain at a checkpoint, so only the balances and supply after a
+ *  checkpoint are compared: in between, a lazy account has not claimed what the baseline has,
+ *  and its claims can succeed where the baseline's fail.
+ *
+ *  It also prints how many actions per second each build ran natively, which only says how
+ *  they compare, not what they cost on chain.
+ *
+ *  usage: equivalence <replay_baseline> <replay> <seed> <steps> [normal|large|near-max|lazy|accrual]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+   struct step {
+      std::string            desc;
+      std::string            outcome;
+      std::vector<std::string> events;
+      std::vector<long long> balances;
+      long long              supply = 0;
+   };
+
+   std::vector<std::string> split( const std::string& line, char sep ) {
+      std::vector<std::string> parts;
+      std::stringstream ss( line );
+      std::string part;
+      while( std::getline( ss, part, sep ) )
+         parts.push_back( part );
+      return parts;
+   }
+
+   std::vector<step> replay( const std::string& command, double& micros ) {
+      std::vector<step> steps;
+      FILE* p = popen( command.c_str(), "r" );
+      if( !p ) {
+         std::perror( command.c_str() );
+         std::exit( 2 );
+      }
+      std::string line;
+      for( int c; (c = std::fgetc( p )) != EOF; ) {
+         if( c != '\n' ) {
+            line += char(c);
+            continue;
+         }
+         auto parts = split( line, '|' );
+         line.clear();
+         if( parts.size() == 2 && parts[0] == "#time" ) {
+            micros = std::atof( parts[1].c_str() );
+            continue;
+         }
+         if( parts.size() != 5 ) {
+            std::fprintf( stderr, "%s: bad line\n", command.c_str() );
+            std::exit( 2 );
+         }
+         step s;
+         s.desc = parts[0];
+         s.outcome = parts[1];
+         std::stringstream events( parts[2] ), balances( parts[3] );
+         for( std::string e; events >> e; )
+            s.events.push_back( e );
+         for( long long b; balances >> b; )
+            s.balances.push_back( b );
+         s.supply = std::atoll( parts[4].c_str() );
+         steps.push_back( s );
+      }
+      if( pclose( p ) != 0 ) {
+         std::fprintf( stderr, "%s: failed\n", command.c_str() );
+         std::exit( 2 );
+      }
+      return steps;
+   }
+
+   std::vector<std::string> without_tax( std::vector<std::string> events ) {
+      std::erase( events, std::string( "tax" ) );
+      return events;
+   }
+
+   std::string join( const std::vector<std::string>& v ) {
+      std::string s;
+      for( const auto& e : v )
+         s += " " + e;
+      return s;
+   }
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+   if( argc < 5 ) {
+      std::fprintf( stderr, "usage: %s <replay_baseline> <replay> <seed> <steps> [normal|large|near-max|lazy|accrual]\n", argv[0] );
+      return 2;
+   }
+   const std::string mode = (argc > 5) ? argv[5] : "normal";
+   const bool lazy = (mode == "lazy");
+   const bool accrual = (mode == "accrual");
+   std::string args = std::string( " " ) + argv[3] + " " + argv[4] + " " + mode;
+   double base_micros = 0, next_micros = 0;
+   const auto base = replay( std::string( "\"" ) + argv[1] + "\"" + args, base_micros );
+   const auto next = replay( std::string( "\"" ) + argv[2] + "\"" + args, next_micros );
+   if( base.size() != next.size() || base.empty() ) {
+      std::fprintf( stderr, "replays have %zu and %zu steps\n", base.size(), next.size() );
+      return 1;
+   }
+
+   std::vector<long long> tolerance( base[0].balances.size(), 0 );
+   long long largest = 0, differing = 0, failed = 0;
+   for( size_t i = 0; i < base.size(); ++i ) {
+      const step& b = base[i];
+      const step& n = next[i];
+      auto fail = [&]( const char* what ) {
+         std::fprintf( stderr, "step %zu (%s): %s differs\n  baseline:%s | %s |", i, b.desc.c_str(), what, join( b.events ).c_str(), b.outcome.c_str() );
+         for( auto x : b.balances ) std::fprintf( stderr, " %lld", x );
+         std::fprintf( stderr, " | %lld\n  this:    %s | %s |", b.supply, join( n.events ).c_str(), n.outcome.c_str() );
+         for( auto x : n.balances ) std::fprintf( stderr, " %lld", x );
+         std::fprintf( stderr, " | %lld\n", n.supply );
+         std::exit( 1 );
+      };
+
+      if( b.desc != n.desc )
+         fail( "action" );
+      if( b.balances.size() != tolerance.size() || n.balances.size() != tolerance.size() )
+         fail( "balance count" );
+      const bool compared = !lazy || b.desc.ends_with( "checkpoint" );
+      for( size_t a = 0; a < tolerance.size(); ++a ) {
+         if( i > 0 && n.balances[a] != next[i - 1].balances[a] )
+            ++tolerance[a];
+      }
+      if( !compared )
+         continue;
+      if( b.outcome != n.outcome )
+         fail( "outcome" );
+      failed += (b.outcome != "ok");
+
+      long long supply_tolerance = 0;
+      bool off = false;
+      for( size_t a = 0; a < tolerance.size(); ++a ) {
+         const long long diff = std::llabs( b.balances[a] - n.balances[a] );
+         if( diff > tolerance[a] )
+            fail( "balance" );
+         off |= (diff != 0);
+         largest = std::max( largest, diff );
+         supply_tolerance += tolerance[a];
+      }
+      if( std::llabs( b.supply - n.supply ) > supply_tolerance )
+         fail( "supply" );
+      off |= (b.supply != n.supply);
+      differing += off;
+
+      if( lazy || accrual )
+         continue;
+      auto be = b.events, ne = n.events;
+      if( off ) {
+         be = without_tax( be );
+         ne = without_tax( ne );
+      }
+      if( be != ne )
+         fail( "events" );
+   }
+
+   std::printf( "%zu steps, %lld failed actions in both, %lld steps with balances off by up to %lld units\n",
+                base.size(), failed, differing, largest );
+   auto per_second = [&]( double micros ) { return (micros > 0) ? base.size() * 1e6 / micros : 0.0; };
+   std::printf( "actions per second (native): baseline %.0f, this %.0f\n", per_second( base_micros ), per_second( next_micros ) );
+   return 0;
+}
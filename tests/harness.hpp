@@ -0,0 +1,158 @@
+/**
+ *  Runs dailycoin actions natively, against the in-memory tables of mock/eosio.
+ */
+#pragma once
+
+#include <dailycoin.hpp>
+
+#include <any>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+
+namespace dailycoin_test {
+
+   using namespace eosio;
+
+   static constexpr name contract_account = "dailycoin"_n;
+   static constexpr symbol XDL = symbol( "XDL", 4 );
+
+   // A tax, income or shareincome notification, whether it was sent on its own or in a batch.
+   struct event {
+      name        type;     // "tax"_n, "income"_n or "shareincome"_n
+      name        owner;    // taxed account, income claimant or share giver
+      name        to;       // share receiver (shareincome only)
+      int64_t     amount = 0;
+   };
+
+   // What an action did. A failed action has rolled back all of its table changes.
+   struct action_result {
+      bool                  ok = false;
+      std::string           error;
+      std::vector<name>     sent;          // inline actions, in the order they were sent
+      std::vector<event>    events;        // the notifications among them, unbatched
+      native::db_counters   db;
+      uint32_t              rows_billed = 0;
+      double                micros = 0;
+   };
+
+   // The notifications carried by an inline action, which is one of them unless it is a batch.
+   inline void unpack_events( name act, const std::any& data, std::vector<event>& events ) {
+      if( act == "tax"_n ) {
+         const auto& d = std::any_cast<const token::tax_notification_abi&>( data );
+         events.push_back( event{ act, d.owner, name(), d.quantity.amount } );
+      } else if( act == "income"_n ) {
+         const auto& d = std::any_cast<const token::income_notification_abi&>( data );
+         events.push_back( event{ act, d.to, name(), d.quantity.amount } );
+      } else if( act == "shareincome"_n ) {
+         const auto& d = std::any_cast<const token::shareincome_notification_abi&>( data );
+         events.push_back( event{ act, d.from, d.to, d.quantity.amount } );
+      }
+#ifdef DAILYCOIN_BATCH_EVENTS
+      static const name types[] = { name(), "tax"_n, "income"_n, "shareincome"_n };
+#ifdef DAILYCOIN_PACKED_EVENTS
+      if( act == "evpack"_n ) {
+         const auto& d = std::any_cast<const std::vector<char>&>( data );
+         token::packed_event_reader reader( d.data(), d.size() );
+         token::packed_event e;
+         while( reader.next( e ) )
+            events.push_back( event{ types[e.type], name(e.owner), name(e.to), e.amount } );
+         check( reader.valid, "invalid event pack" );
+      }
+#else
+      if( act == "events"_n ) {
+         for( const auto& e : std::any_cast<const std::vector<token::event_abi>&>( data ) )
+            events.push_back( event{ types[e.type], e.owner, e.to, e.quantity.amount } );
+      }
+#endif
+#endif
+   }
+
+   class harness {
+   public:
+      explicit harness( std::initializer_list<name> accounts = {} ) {
+         auto& c = native::chain::get();
+         c.self = contract_account;
+         c.reset();
+         for( auto a : accounts )
+            add_account( a );
+         set_day( 19000 );
+      }
+
+      void add_account( name account ) { native::chain::get().accounts.insert( account.value ); }
+
+      // One hour into "day", so that "today" is that day.
+      void set_day( int64_t day ) { native::chain::get().now_us = day * 86400000000ll + 3600000000ll; }
+      void advance_days( int64_t days ) { native::chain::get().now_us += days * 86400000000ll; }
+
+      // Runs "act" on a fresh contract object, as one action authorized by "auths".
+      action_result run( std::vector<name> auths, const std::function<void(token&)>& act ) {
+         auto& c = native::chain::get();
+         c.auths.clear();
+         for( auto a : auths )
+            c.auths.insert( a.value );
+         c.sent.clear();
+         c.sent_data.clear();
+         c.db = native::db_counters{};
+         c.billed.clear();
+         for( auto t : c.tables )
+            t->save();
+
+         action_result r;
+         const auto start = std::chrono::steady_clock::now();
+         try {
+            token contract( contract_account, contract_account, datastream<const char*>() );
+            act( contract );
+            r.ok = true;
+         } catch( const check_failure& e ) {
+            r.error = e.what();
+         }
+         r.micros = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count();
+
+         if( !r.ok ) {
+            for( auto t : c.tables )
+               t->rollback();
+            c.sent.clear();
+            c.sent_data.clear();
+         }
+         r.sent = c.sent;
+         for( size_t i = 0; i < c.sent.size(); ++i )
+            unpack_events( c.sent[i], c.sent_data[i], r.events );
+         r.db = c.db;
+         for( const auto& b : c.billed )
+            r.rows_billed += b.second;
+         return r;
+      }
+
+      // The owner's balance row, or -1 if they have none.
+      int64_t balance( name owner, symbol_code sym = XDL.code() ) {
+         try {
+            return token::get_balance( contract_account, owner, sym ).amount;
+         } catch( const check_failure& ) {
+            return -1;
+         }
+      }
+
+      int64_t supply( symbol_code sym = XDL.code() ) {
+         return token::get_supply( contract_account, sym ).amount;
+      }
+
+      // Rows of the contract's "table" in "scope", looked up by table name.
+      size_t rows( name table, uint64_t scope ) {
+         const native::table_base* t = native::chain::get().table( table );
+         return t ? t->count( contract_account, scope ) : 0;
+      }
+
+      bool has_row( name table, uint64_t scope, uint64_t pk ) {
+         const native::table_base* t = native::chain::get().table( table );
+         return t && t->contains( contract_account, scope, pk );
+      }
+
+      // The account billed for a row, or no name if there is no such row.
+      name payer( name table, uint64_t scope, uint64_t pk ) {
+         const native::table_base* t = native::chain::get().table( table );
+         return t ? t->payer( contract_account, scope, pk ) : name();
+      }
+   };
+
+} // namespace dailycoin_test
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+
+namespace eosio {
+
+   struct symbol_code {
+      uint64_t value = 0;
+
+      constexpr symbol_code() = default;
+      constexpr explicit symbol_code( uint64_t raw ) : value(raw) {}
+      constexpr explicit symbol_code( std::string_view str ) {
+         for( auto it = str.rbegin(); it != str.rend(); ++it )
+            value = (value << 8) | uint8_t(*it);
+      }
+
+      constexpr uint64_t raw()const { return value; }
+      constexpr bool is_valid()const { return value != 0; }
+      std::string to_string()const {
+         std::string str;
+         for( uint64_t v = value; v; v >>= 8 )
+            str += char(v & 0xFF);
+         return str;
+      }
+
+      friend constexpr bool operator==( symbol_code a, symbol_code b ) { return a.value == b.value; }
+      friend constexpr bool operator!=( symbol_code a, symbol_code b ) { return a.value != b.value; }
+   };
+
+   struct symbol {
+      uint64_t value = 0;
+
+      constexpr symbol() = default;
+      constexpr explicit symbol( uint64_t raw ) : value(raw) {}
+      constexpr symbol( symbol_code sc, uint8_t precision ) : value((sc.raw() << 8) | precision) {}
+      constexpr symbol( std::string_view sc, uint8_t precision ) : symbol(symbol_code(sc), precision) {}
+
+      constexpr uint64_t raw()const { return value; }
+      constexpr symbol_code code()const { return symbol_code( value >> 8 ); }
+      constexpr uint8_t precision()const { return value & 0xFF; }
+      constexpr bool is_valid()const { return code().is_valid(); }
+
+      friend constexpr bool operator==( symbol a, symbol b ) { return a.value == b.value; }
+      friend constexpr bool operator!=( symbol a, symbol b ) { return a.value != b.value; }
+   };
+
+   struct asset {
+      static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+      int64_t        amount = 0;
+      eosio::symbol  symbol;
+
+      asset() = default;
+      constexpr asset( int64_t a, eosio::symbol s ) : amount(a), symbol(s) {}
+
+      bool is_amount_within_range()const { return -max_amount <= amount && amount <= max_amount; }
+      bool is_valid()const { return is_amount_within_range() && symbol.is_valid(); }
+      void set_amount( int64_t a ) {
+         amount = a;
+         check( is_amount_within_range(), "magnitude of asset amount must be less than 2^62" );
+      }
+
+      asset operator-()const { return asset( -amount, symbol ); }
+      asset& operator-=( const asset& a ) {
+         check( a.symbol == symbol, "attempt to subtract asset with different symbol" );
+         amount -= a.amount;
+         check( -max_amount <= amount, "subtraction underflow" );
+         return *this;
+      }
+      asset& operator+=( const asset& a ) {
+         check( a.symbol == symbol, "attempt to add asset with different symbol" );
+         amount += a.amount;
+         check( amount <= max_amount, "addition overflow" );
+         return *this;
+      }
+      friend asset operator+( asset a, const asset& b ) { return a += b; }
+      friend asset operator-( asset a, const asset& b ) { return a -= b; }
+      friend bool operator==( const asset& a, const asset& b ) { return a.amount == b.amount && a.symbol == b.symbol; }
+      friend bool operator!=( const asset& a, const asset& b ) { return !(a == b); }
+      friend bool operator<( const asset& a, const asset& b ) { return a.amount < b.amount; }
+      friend bool operator>( const asset& a, const asset& b ) { return a.amount > b.amount; }
+   };
+
+} // namespace eosio
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <optional>
+#include <utility>
+
+namespace eosio {
+
+   template<typename T>
+   class binary_extension {
+   public:
+      binary_extension() = default;
+      binary_extension( const T& v ) : _v(v) {}
+
+      bool has_value()const { return _v.has_value(); }
+      T& value() { return *_v; }
+      const T& value()const { return *_v; }
+      T value_or( const T& def = T() )const { return _v ? *_v : def; }
+      template<typename... Args>
+      T& emplace( Args&&... args ) { return _v.emplace( std::forward<Args>(args)... ); }
+      void reset() { _v.reset(); }
+
+   private:
+      std::optional<T> _v;
+   };
+
+} // namespace eosio
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace eosio {
+
+   struct checksum256 {
+      std::array<uint64_t, 4> words{};
+      friend bool operator==( const checksum256& a, const checksum256& b ) { return a.words == b.words; }
+      friend bool operator!=( const checksum256& a, const checksum256& b ) { return a.words != b.words; }
+   };
+
+   // Not SHA-256: an FNV-1a digest plus the length is enough to tell test profiles apart.
+   inline checksum256 sha256( const char* data, size_t length ) {
+      checksum256 c;
+      uint64_t h = 14695981039346656037ull;
+      for( size_t i = 0; i < length; ++i )
+         h = (h ^ uint8_t(data[i])) * 1099511628211ull;
+      c.words[0] = h;
+      c.words[1] = length;
+      return c;
+   }
+
+} // namespace eosio
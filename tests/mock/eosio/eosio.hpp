@@ -0,0 +1,220 @@
+/**
+ *  In-memory stand-ins for the parts of the eosio CDT that the contract uses, so that it can be
+ *  compiled natively and driven by the tests in this directory. Only what dailycoin calls is here.
+ */
+#pragma once
+
+#include <algorithm>
+#include <any>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace eosio {
+
+   // A failed check() aborts the action; harness::run() catches it and rolls the tables back.
+   struct check_failure : std::runtime_error {
+      using std::runtime_error::runtime_error;
+   };
+
+   inline void check( bool pred, const char* msg ) { if( !pred ) throw check_failure( msg ); }
+   inline void check( bool pred, const std::string& msg ) { if( !pred ) throw check_failure( msg ); }
+
+   struct name {
+      uint64_t value = 0;
+
+      constexpr name() = default;
+      constexpr explicit name( uint64_t v ) : value(v) {}
+      constexpr explicit name( std::string_view str ) {
+         int n = 0;
+         for( char c : str ) {
+            if( n == 12 )
+               break;
+            value = (value << 5) | char_to_value( c );
+            ++n;
+         }
+         value <<= 4 + 5 * (12 - n);
+         if( str.size() == 13 )
+            value |= char_to_value( str[12] ) & 0x0F;
+      }
+
+      static constexpr uint64_t char_to_value( char c ) {
+         if( c >= '1' && c <= '5' ) return (c - '1') + 1;
+         if( c >= 'a' && c <= 'z' ) return (c - 'a') + 6;
+         return 0;
+      }
+
+      std::string to_string()const {
+         static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+         std::string str( 13, '.' );
+         uint64_t tmp = value;
+         for( int i = 0; i <= 12; ++i ) {
+            str[12 - i] = charmap[tmp & (i == 0 ? 0x0F : 0x1F)];
+            tmp >>= (i == 0 ? 4 : 5);
+         }
+         str.erase( str.find_last_not_of( '.' ) + 1 );
+         return str;
+      }
+
+      constexpr explicit operator bool()const { return value != 0; }
+      friend constexpr bool operator==( name a, name b ) { return a.value == b.value; }
+      friend constexpr bool operator!=( name a, name b ) { return a.value != b.value; }
+      friend constexpr bool operator<( name a, name b ) { return a.value < b.value; }
+   };
+
+   inline namespace literals {
+      template <typename T, T... Str>
+      constexpr name operator""_n() {
+         constexpr char str[] = { Str... };
+         return name( std::string_view( str, sizeof...(Str) ) );
+      }
+   }
+
+   static constexpr name same_payer{};
+
+   struct permission_level {
+      name actor;
+      name permission;
+   };
+
+   namespace native {
+
+      // Database calls, like the ones DAILYCOIN_INSTRUMENT counts, but made by the whole action.
+      struct db_counters {
+         uint64_t finds = 0;
+         uint64_t modifies = 0;
+         uint64_t emplaces = 0;
+         uint64_t erases = 0;
+         uint64_t nexts = 0;
+      };
+
+      // Every multi_index type registers its rows here, so that a failed action can be undone,
+      //   and so that tests can look rows up by table name without the contract's row types.
+      struct table_base {
+         name table_name;
+
+         explicit table_base( name table_name ) : table_name(table_name) {}
+         virtual ~table_base() = default;
+         virtual void save() = 0;
+         virtual void rollback() = 0;
+         virtual void clear() = 0;
+         virtual size_t count( name code, uint64_t scope )const = 0;
+         virtual bool contains( name code, uint64_t scope, uint64_t pk )const = 0;
+         virtual name payer( name code, uint64_t scope, uint64_t pk )const = 0;
+      };
+
+      // The chain state seen by the contract: the clock, the accounts, the authorizations of the
+      //   current action, and what it did.
+      struct chain {
+         int64_t                        now_us = 0;
+         name                           self;
+         std::set<uint64_t>             accounts;
+         std::set<uint64_t>             auths;
+         std::vector<name>              sent;       // inline actions, in the order they were sent
+         std::vector<std::any>          sent_data;  // and their data
+         db_counters                    db;
+         std::map<uint64_t, uint32_t>   billed;     // rows billed to each account
+         std::vector<table_base*>       tables;
+
+         static chain& get() { static chain c; return c; }
+
+         // Back to an empty chain, keeping only the contract account.
+         void reset() {
+            for( auto t : tables )
+               t->clear();
+            now_us = 0;
+            accounts = { self.value };
+            auths.clear();
+            sent.clear();
+            sent_data.clear();
+            db = db_counters{};
+            billed.clear();
+         }
+
+         // The table named "table_name", if the contract has used it yet.
+         const table_base* table( name table_name )const {
+            for( auto t : tables )
+               if( t->table_name == table_name )
+                  return t;
+            return nullptr;
+         }
+
+         // The contract can bill its own RAM; anyone else has to have authorized the action.
+         void bill( name payer ) {
+            check( payer == self || auths.count( payer.value ), "missing authority of " + payer.to_string() );
+            ++billed[payer.value];
+         }
+      };
+
+   } // namespace native
+
+   inline bool is_account( name n ) { return native::chain::get().accounts.count( n.value ) > 0; }
+   inline bool has_auth( name n ) { return native::chain::get().auths.count( n.value ) > 0; }
+   inline void require_auth( name n ) { check( has_auth( n ), "missing authority of " + n.to_string() ); }
+   inline void require_recipient( name ) {}
+
+   struct microseconds {
+      int64_t _count = 0;
+      int64_t count()const { return _count; }
+   };
+
+   struct time_point {
+      microseconds elapsed;
+      const microseconds& time_since_epoch()const { return elapsed; }
+   };
+
+   inline time_point current_time_point() { return time_point{ microseconds{ native::chain::get().now_us } }; }
+
+   template<typename... Args>
+   void print( Args&&... args ) { (std::cout << ... << args); }
+
+   template<typename T>
+   struct datastream {};
+
+   class contract {
+   public:
+      contract( name self, name first_receiver, datastream<const char*> ) : _self(self), _first_receiver(first_receiver) {}
+      name get_self()const { return _self; }
+   protected:
+      name _self;
+      name _first_receiver;
+   };
+
+   // Inline actions are recorded with their data, which tests can std::any_cast back to the
+   //   contract's notification structs. The data of action_wrapper and SEND_INLINE_ACTION sends
+   //   is not kept.
+   struct action {
+      template<typename P, typename T>
+      action( const P&, name, name act, const T& data ) : act(act), data(data) {}
+      void send()const {
+         native::chain::get().sent.push_back( act );
+         native::chain::get().sent_data.push_back( data );
+      }
+      name act;
+      std::any data;
+   };
+
+   template<name Action, auto Method>
+   struct action_wrapper {
+      template<typename P>
+      action_wrapper( name, const P& ) {}
+      template<typename... Args>
+      void send( Args&&... )const {
+         native::chain::get().sent.push_back( Action );
+         native::chain::get().sent_data.emplace_back();
+      }
+   };
+
+} // namespace eosio
+
+#define SEND_INLINE_ACTION( CONTRACT, NAME, ... ) \
+   ( eosio::native::chain::get().sent.push_back( eosio::name( #NAME ) ), eosio::native::chain::get().sent_data.emplace_back() )
+#define EOSIO_DISPATCH( TYPE, MEMBERS )
+
+#include <eosio/multi_index.hpp>
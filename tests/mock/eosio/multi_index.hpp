@@ -0,0 +1,210 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+
+#include <tuple>
+#include <type_traits>
+
+namespace eosio {
+
+   template<name IndexName, typename Extractor>
+   struct indexed_by {
+      static constexpr name index_name = IndexName;
+      using extractor = Extractor;
+   };
+
+   template<typename Class, typename Type, Type (Class::*PtrToMemberFunction)()const>
+   struct const_mem_fun {
+      using result_type = Type;
+      Type operator()( const Class& c )const { return (c.*PtrToMemberFunction)(); }
+   };
+
+   // Rows are kept per (code, scope) in a std::map ordered by primary key, with the account that
+   //   pays for each one. Secondary indices are found by scanning the scope.
+   template<name TableName, typename T, typename... Indices>
+   class multi_index {
+      using rows_t = std::map<uint64_t, T>;
+      using payers_t = std::map<uint64_t, name>;
+      using scope_t = std::pair<uint64_t, uint64_t>;
+
+      struct table : native::table_base {
+         std::map<scope_t, rows_t>    rows, saved_rows;
+         std::map<scope_t, payers_t>  payers, saved_payers;
+
+         table() : table_base(TableName) { native::chain::get().tables.push_back( this ); }
+         void save() override { saved_rows = rows; saved_payers = payers; }
+         void rollback() override { rows = saved_rows; payers = saved_payers; }
+         void clear() override { rows.clear(); payers.clear(); saved_rows.clear(); saved_payers.clear(); }
+
+         size_t count( name code, uint64_t scope )const override {
+            auto it = rows.find( {code.value, scope} );
+            return (it == rows.end()) ? 0 : it->second.size();
+         }
+         bool contains( name code, uint64_t scope, uint64_t pk )const override {
+            auto it = rows.find( {code.value, scope} );
+            return it != rows.end() && it->second.count( pk );
+         }
+         name payer( name code, uint64_t scope, uint64_t pk )const override {
+            auto it = payers.find( {code.value, scope} );
+            if( it == payers.end() )
+               return name();
+            auto p = it->second.find( pk );
+            return (p == it->second.end()) ? name() : p->second;
+         }
+      };
+
+      static table& store() { static table t; return t; }
+
+      native::db_counters& db()const { return native::chain::get().db; }
+      rows_t& rows()const { return store().rows[{_code.value, _scope}]; }
+      payers_t& payers()const { return store().payers[{_code.value, _scope}]; }
+
+      name      _code;
+      uint64_t  _scope;
+
+   public:
+      struct const_iterator {
+         const multi_index*  tbl = nullptr;
+         bool                is_end = true;
+         uint64_t            pk = 0;
+
+         const T& operator*()const { return tbl->rows().at( pk ); }
+         const T* operator->()const { return &tbl->rows().at( pk ); }
+         const_iterator& operator++() {
+            ++tbl->db().nexts;
+            auto it = tbl->rows().upper_bound( pk );
+            is_end = (it == tbl->rows().end());
+            if( !is_end )
+               pk = it->first;
+            return *this;
+         }
+         friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a.is_end == b.is_end && (a.is_end || a.pk == b.pk); }
+         friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return !(a == b); }
+      };
+      using iterator = const_iterator;
+
+      multi_index( name code, uint64_t scope ) : _code(code), _scope(scope) {}
+
+      name get_code()const { return _code; }
+      uint64_t get_scope()const { return _scope; }
+
+      const_iterator end()const { return const_iterator{ this }; }
+      const_iterator begin()const { ++db().finds; return at( rows().begin() ); }
+      const_iterator find( uint64_t pk )const { ++db().finds; return at( rows().find( pk ) ); }
+      const_iterator lower_bound( uint64_t pk )const { ++db().finds; return at( rows().lower_bound( pk ) ); }
+      const_iterator upper_bound( uint64_t pk )const { ++db().finds; return at( rows().upper_bound( pk ) ); }
+
+      const T& get( uint64_t pk, const char* error_msg = "unable to find key" )const {
+         auto it = find( pk );
+         check( it != end(), error_msg );
+         return *it;
+      }
+
+      template<typename Lambda>
+      const_iterator emplace( name payer, Lambda&& constructor ) {
+         check( payer.value != 0, "cannot pass empty payer to emplace" );
+         ++db().emplaces;
+         T obj{};
+         constructor( obj );
+         const uint64_t pk = obj.primary_key();
+         check( !rows().count( pk ), "could not insert object, most likely a uniqueness constraint was violated" );
+         native::chain::get().bill( payer );
+         rows().emplace( pk, obj );
+         payers()[pk] = payer;
+         return at( rows().find( pk ) );
+      }
+
+      template<typename Lambda>
+      void modify( const_iterator itr, name payer, Lambda&& updater ) {
+         check( !itr.is_end, "cannot pass end iterator to modify" );
+         modify( *itr, payer, std::forward<Lambda>( updater ) );
+      }
+
+      template<typename Lambda>
+      void modify( const T& obj, name payer, Lambda&& updater ) {
+         ++db().modifies;
+         const uint64_t pk = obj.primary_key();
+         auto it = rows().find( pk );
+         check( it != rows().end() && &it->second == &obj, "object passed to modify is not in multi_index" );
+         updater( it->second );
+         check( it->second.primary_key() == pk, "updater cannot change primary key when modifying an object" );
+         if( payer != same_payer && payer != payers()[pk] ) {
+            native::chain::get().bill( payer );
+            payers()[pk] = payer;
+         }
+      }
+
+      const_iterator erase( const_iterator itr ) {
+         check( !itr.is_end, "cannot pass end iterator to erase" );
+         ++db().erases;
+         auto next = at( rows().upper_bound( itr.pk ) );
+         rows().erase( itr.pk );
+         payers().erase( itr.pk );
+         return next;
+      }
+
+      void erase( const T& obj ) { erase( at( rows().find( obj.primary_key() ) ) ); }
+
+      template<typename Index>
+      class secondary_index {
+         using key_t = typename Index::extractor::result_type;
+         using entry = std::pair<key_t, uint64_t>;
+
+      public:
+         struct const_iterator {
+            const secondary_index*  idx = nullptr;
+            bool                    is_end = true;
+            entry                   pos{};
+
+            const T& operator*()const { return idx->tbl->rows().at( pos.second ); }
+            const T* operator->()const { return &idx->tbl->rows().at( pos.second ); }
+            const_iterator& operator++() {
+               ++idx->tbl->db().nexts;
+               *this = idx->first_after( pos, false );
+               return *this;
+            }
+            friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a.is_end == b.is_end && (a.is_end || a.pos == b.pos); }
+            friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return !(a == b); }
+         };
+
+         explicit secondary_index( const multi_index* tbl ) : tbl(tbl) {}
+
+         const_iterator end()const { return const_iterator{ this }; }
+         const_iterator begin()const { ++tbl->db().finds; return first_after( entry{}, true ); }
+         const_iterator lower_bound( key_t key )const { ++tbl->db().finds; return first_after( entry{ key, 0 }, true ); }
+
+      private:
+         // The first row whose (key, primary key) comes after "from", or is equal to it if "inclusive".
+         const_iterator first_after( const entry& from, bool inclusive )const {
+            const_iterator best{ this };
+            for( const auto& row : tbl->rows() ) {
+               entry e{ typename Index::extractor()( row.second ), row.first };
+               if( (inclusive ? !(e < from) : from < e) && (best.is_end || e < best.pos) ) {
+                  best.is_end = false;
+                  best.pos = e;
+               }
+            }
+            return best;
+         }
+
+         const multi_index* tbl;
+      };
+
+      template<name IndexName>
+      auto get_index()const {
+         using found = decltype( std::tuple_cat( std::conditional_t<Indices::index_name == IndexName, std::tuple<Indices>, std::tuple<>>{}... ) );
+         return secondary_index<std::tuple_element_t<0, found>>( this );
+      }
+
+   private:
+      const_iterator at( typename rows_t::const_iterator it )const {
+         const_iterator c{ this };
+         if( it != rows().end() ) {
+            c.is_end = false;
+            c.pk = it->first;
+         }
+         return c;
+      }
+   };
+
+} // namespace eosio
@@ -0,0 +1,241 @@
+/**
+ *  Replays a random history of actions and prints one line per step: the action, whether it
+ *  failed and why, the inline actions it sent, every balance and the supply. It only uses the
+ *  actions and readers that the baseline contract already had, so the same history can be
+ *  replayed against both builds and compared (see equivalence.cpp).
+ *
+ *  The last line is the time spent in the actions, in microseconds.
+ *
+ *  The "lazy" and "accrual" modes replay the history with every user in lazy settlement or share
+ *  accrual mode, which the baseline doesn't have, so this build switches them on without printing
+ *  anything. In "accrual" mode the share pools are paid with payshares after each step, as part of
+ *  it. In "lazy" mode an account that receives keeps its income until a "checkpoint" step claims
+ *  for all users, before every change of day, share change and burn: only after one can the two
+ *  builds agree. Both modes use the amounts of "normal".
+ *
+ *  usage: replay <seed> <steps> [normal|large|near-max|lazy|accrual]
+ */
+#include "harness.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace dailycoin_test;
+
+namespace {
+
+   // The balance in the owner's row, before the tax it owes today: get_balance() of this build
+   //   takes that tax off, the baseline's does not.
+   int64_t stored_balance( harness& h, name owner ) {
+#ifdef DAILYCOIN_REPLAY_BASELINE
+      return h.balance( owner );
+#else
+      try {
+         const auto view = token::get_balance_view( contract_account, owner, XDL.code() );
+         return view.balance.amount + view.pending_tax.amount;
+      } catch( const check_failure& ) {
+         return -1;
+      }
+#endif
+   }
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+   if( argc < 3 ) {
+      std::fprintf( stderr, "usage: %s <seed> <steps> [normal|large|near-max|lazy|accrual]\n", argv[0] );
+      return 2;
+   }
+   const uint64_t seed = std::strtoull( argv[1], nullptr, 10 );
+   const int steps = std::atoi( argv[2] );
+   // "large" balances (up to 4 * 10^8 XDL) are big enough for the demurrage tax to differ by one
+   //   unit. "near-max" has max_supply just above what was issued, so that claims get cut down
+   //   to what is left of the supply, or fail.
+   const std::string mode = (argc > 3) ? argv[3] : "normal";
+   const bool large = (mode == "large");
+   const bool near_max = (mode == "near-max");
+   const bool lazy = (mode == "lazy");
+   const bool accrual = (mode == "accrual");
+   if( !large && !near_max && !lazy && !accrual && mode != "normal" ) {
+      std::fprintf( stderr, "unknown mode %s\n", mode.c_str() );
+      return 2;
+   }
+
+   std::mt19937_64 rng( seed );
+   auto R = [&]( int64_t n ) { return int64_t(rng() % uint64_t(n)); };
+
+   const name dao = "dao"_n;
+   const std::vector<name> users = { "alice"_n, "bob"_n, "carol"_n, "dave"_n, "erin"_n, "frank"_n, "gina"_n, "hank"_n };
+   harness h( { dao } );
+   for( auto u : users )
+      h.add_account( u );
+
+   int64_t max_supply = 1000000000000000ll, issued = 5000000000ll;
+   if( large ) {
+      max_supply = 40000000000000ll;
+      issued = max_supply - 2000000ll;
+   } else if( near_max ) {
+      issued = 2000000000ll;
+      max_supply = issued + 2000000ll;
+   }
+   const int64_t big = issued / 10;
+
+   double micros = 0;
+   // The inline actions sent, with the notifications listed one by one whether or not the build
+   //   batches them.
+   auto sent_names = []( const action_result& r, std::vector<name>& sent ) {
+      for( auto s : r.sent ) {
+         if( s != "tax"_n && s != "income"_n && s != "shareincome"_n && s != "events"_n && s != "evpack"_n )
+            sent.push_back( s );
+      }
+      for( const auto& e : r.events )
+         sent.push_back( e.type );
+   };
+   auto print = [&]( const std::string& desc, const std::string& outcome, std::vector<name>& sent ) {
+      std::sort( sent.begin(), sent.end() );
+      std::printf( "%s|%s|", desc.c_str(), outcome.c_str() );
+      for( auto s : sent )
+         std::printf( " %s", s.to_string().c_str() );
+      std::printf( "|" );
+      for( auto u : users )
+         std::printf( " %lld", (long long)stored_balance( h, u ) );
+      std::printf( " %lld|%lld\n", (long long)stored_balance( h, dao ), (long long)h.supply() );
+   };
+   // Pays every share pool until none is left, since paying shares can fill the pools of the
+   //   recipients. The baseline has no pools.
+   auto pay_pools = [&]( std::vector<name>& sent ) {
+#ifndef DAILYCOIN_REPLAY_BASELINE
+      for( bool paid = accrual; paid; ) {
+         paid = false;
+         for( auto u : users ) {
+            action_result r = h.run( { u }, [&]( token& c ) { c.payshares( u, u ); } );
+            micros += r.micros;
+            sent_names( r, sent );
+            paid |= r.ok;
+         }
+      }
+#else
+      (void)sent;
+#endif
+   };
+   auto step = [&]( const std::string& desc, std::vector<name> auths, const std::function<void(token&)>& act ) {
+      action_result r = h.run( auths, act );
+      micros += r.micros;
+      std::vector<name> sent;
+      sent_names( r, sent );
+      pay_pools( sent );
+      print( desc, r.ok ? "ok" : "FAIL " + r.error, sent );
+   };
+   // Claims for every user, whether or not they have anything to claim.
+   auto checkpoint = [&]( const std::string& desc ) {
+      std::vector<name> sent;
+      for( auto u : users ) {
+         action_result r = h.run( { u }, [&]( token& c ) { c.claim( u ); } );
+         micros += r.micros;
+         sent_names( r, sent );
+      }
+      print( desc, "ok", sent );
+   };
+
+   step( "create", { contract_account }, [&]( token& c ) { c.create( dao, asset( max_supply, XDL ) ); } );
+   step( "issue", { dao }, [&]( token& c ) { c.issue( dao, asset( issued, XDL ), "" ); } );
+   // Every user starts with at least big / 2, which all the seeds together can afford. The
+   //   baseline only moves an account's last claim day when it pays some tax, so an account too
+   //   small to be taxed can claim a day of income again and again there; that was fixed, and
+   //   these histories stay clear of it.
+   for( auto u : users ) {
+      const int64_t amount = big / 2 + R( big / 2 );
+      step( "seed " + u.to_string(), { dao }, [&]( token& c ) { c.transfer( dao, u, asset( amount, XDL ), "" ); } );
+   }
+#ifndef DAILYCOIN_REPLAY_BASELINE
+   for( auto u : users ) {
+      if( lazy )
+         h.run( { u }, [&]( token& c ) { c.setlazy( u, true ); } );
+      if( accrual )
+         h.run( { u }, [&]( token& c ) { c.setaccrual( u, true ); } );
+   }
+#endif
+
+   for( int i = 0; i < steps; ++i ) {
+      const int op = R( 100 );
+      const name a = users[R( users.size() )];
+      const name b = users[R( users.size() )];
+      const std::string tag = std::to_string( i ) + " ";
+      if( op < 10 ) {
+         // Lazy accounts claim at most max_past_claim_days of the income they kept, so there are
+         //   no long gaps in that mode, and the checkpoint is on the last day before the gap.
+         const int64_t days = (R( 10 ) == 0 && !lazy) ? 300 + R( 900 ) : R( 3 );
+         if( lazy )
+            checkpoint( tag + "checkpoint" );
+         h.advance_days( days );
+         step( tag + "advance " + std::to_string( days ), {}, []( token& ) {} );
+      } else if( op < 25 ) {
+         step( tag + "claim " + a.to_string(), { a }, [&]( token& c ) { c.claim( a ); } );
+      } else if( op < 32 ) {
+         step( tag + "claimfor " + a.to_string() + " " + b.to_string(), { b }, [&]( token& c ) { c.claimfor( a, b ); } );
+      } else if( op < 62 ) {
+         const int64_t amount = 1 + R( (R( 5 ) == 0) ? big : 20000000ll );
+         step( tag + "transfer " + a.to_string() + " " + b.to_string() + " " + std::to_string( amount ), { a },
+               [&]( token& c ) { c.transfer( a, b, asset( amount, XDL ), "" ); } );
+      } else if( op < 74 && near_max ) {
+         // Which share gets the last of the supply depends on the order the shares are paid in,
+         //   which is now breadth first, so there are no shares near max_supply.
+         step( tag + "claim " + a.to_string(), { a }, [&]( token& c ) { c.claim( a ); } );
+      } else if( op < 72 ) {
+         // The income a lazy account kept is shared by the shares it has when it claims, so
+         //   that has to be before its shares change. In accrual mode shares only go to a user
+         //   with a greater name: a claim that cascades back to the claimant pays it before its
+         //   debit in the baseline, but only with the next payshares here.
+         const int64_t percent = (R( 4 ) == 0) ? 0 : R( 70 );
+         if( lazy )
+            checkpoint( tag + "checkpoint" );
+         const name owner = (accrual && b < a) ? b : a;
+         const name to = (accrual && b < a) ? a : b;
+         step( tag + "setshare " + owner.to_string() + " " + to.to_string() + " " + std::to_string( percent ), { owner },
+               [&]( token& c ) { c.setshare( owner, to, percent ); } );
+      } else if( op < 74 ) {
+         if( lazy )
+            checkpoint( tag + "checkpoint" );
+         step( tag + "resetshare " + a.to_string(), { a }, [&]( token& c ) { c.resetshare( a ); } );
+      } else if( op < 80 ) {
+         // burn doesn't settle the tax first, so it takes the tax on the burned amount with it
+         //   from an account that hasn't been settled today, and that has to be the same accounts
+         //   as in the baseline.
+         const int64_t amount = 1 + R( 1000000ll );
+         if( lazy )
+            checkpoint( tag + "checkpoint" );
+         step( tag + "burn " + a.to_string() + " " + std::to_string( amount ), { a }, [&]( token& c ) { c.burn( a, asset( amount, XDL ) ); } );
+      } else if( op < 86 && lazy ) {
+         // A lazy account hasn't always claimed on a day it received, so it could be closed on
+         //   days when the baseline couldn't close it, and a new row wouldn't be lazy.
+         step( tag + "claim " + a.to_string(), { a }, [&]( token& c ) { c.claim( a ); } );
+      } else if( op < 86 ) {
+         step( tag + "close " + a.to_string(), { a }, [&]( token& c ) { c.close( a, XDL ); } );
+      } else if( op < 90 ) {
+         step( tag + "open " + a.to_string() + " " + b.to_string(), { b }, [&]( token& c ) { c.open( a, XDL, b ); } );
+      } else if( op < 95 ) {
+         // Near max_supply, of any order of magnitude, so that the issues that fit keep taking
+         //   the supply back to within a few claims of the limit.
+         int64_t amount = 1 + R( 100000000ll );
+         if( near_max ) {
+            amount = 1 + R( 9 );
+            for( int64_t digits = R( 13 ); digits > 0; --digits )
+               amount *= 10;
+         }
+         step( tag + "issue " + std::to_string( amount ), { dao }, [&]( token& c ) { c.issue( dao, asset( amount, XDL ), "" ); } );
+      } else if( op < 98 ) {
+         const int64_t amount = 1 + R( 1000000ll );
+         step( tag + "retire " + std::to_string( amount ), { dao }, [&]( token& c ) { c.retire( asset( amount, XDL ), "" ); } );
+      } else {
+         const std::string profile( R( 40 ), 'x' );
+         step( tag + "setprofile " + a.to_string(), { a }, [&]( token& c ) { c.setprofile( a, profile ); } );
+      }
+   }
+   if( lazy )
+      checkpoint( "checkpoint" );
+   std::printf( "#time|%.0f\n", micros );
+   return 0;
+}